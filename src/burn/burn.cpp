@@ -37,6 +37,9 @@ INT32 nFMInterpolation = 0;			// Desired interpolation level for FM sound
 UINT8 nBurnLayer = 0xFF;	// Can be used externally to select which layers to show
 UINT8 nSpriteEnable = 0xFF;	// Can be used externally to select which Sprites to show
 UINT8 nSkipFrame = 0;		// Can be used to skip rendering of the current frame
+bool bBurnNoRender = false;	// Can be used to skip rendering and sound synthesis altogether
+UINT32 nBurnNVRAMChanges = 0;	// Bumped by drivers whenever they change battery backed memory
+INT64 nBurnClockTime = 0;		// If not 0, the time real-time clocks start from instead of the host's
 
 INT32 nMaxPlayers;
 
@@ -564,6 +567,7 @@ extern "C" INT32 BurnDrvExit()
 	
 	INT32 nRet = pDriver[nBurnDrvActive]->Exit();			// Forward to drivers function
 	
+	BurnUnmapRoms();
 	BurnExitMemoryManager();
 	return nRet;
 }
@@ -657,6 +661,9 @@ INT32 BurnByteswap(UINT8* pMem, INT32 nLen)
 
 // Application-defined rom loading function:
 INT32 (__cdecl *BurnExtLoadRom)(UINT8 *Dest, INT32 *pnWrote, INT32 i) = NULL;
+INT32 (__cdecl *BurnExtLoadRomChunked)(INT32 i, INT32 *pnWrote, BurnLoadRomChunk pChunk, void *pParam) = NULL;
+INT32 (__cdecl *BurnExtFindStoredRom)(INT32 i, char *pszFile, INT32 nFileLen, INT64 *pnOffset) = NULL;
+INT32 (__cdecl *BurnExtGetRomCrc)(INT32 i, UINT32 *pnCrc) = NULL;
 
 // Application-defined colour conversion function
 static UINT32 __cdecl BurnHighColFiller(INT32, INT32, INT32, INT32) { return (UINT32)(~0); }
@@ -682,6 +689,54 @@ static BurnStateEntry* pStateEntryAnchor = NULL;
 typedef void (*BurnPostloadFunction)();
 static BurnPostloadFunction BurnPostload[8];
 
+// The registered variables in scan order, flattened into one array the first time they are scanned.
+// Variables that follow each other in memory as well as in the list are merged into one area, which
+// keeps the state byte for byte the same. The FM cores register well over a hundred of them, mostly a
+// byte or a word each
+struct BurnStateArea { void* pValue; UINT32 nSize; char* szName; };
+
+static BurnStateArea* pStateTable = NULL;
+static INT32 nStateTableLen = 0;
+
+static void BurnStateTableExit()
+{
+	if (pStateTable) {
+		free(pStateTable);
+		pStateTable = NULL;
+	}
+	nStateTableLen = 0;
+}
+
+static void BurnStateTableInit()
+{
+	INT32 nEntries = 0;
+
+	BurnStateTableExit();
+
+	for (BurnStateEntry* pEntry = pStateEntryAnchor; pEntry; pEntry = pEntry->pNext) {
+		nEntries++;
+	}
+
+	pStateTable = (BurnStateArea*)malloc(nEntries * sizeof(BurnStateArea));
+	if (pStateTable == NULL) {
+		return;
+	}
+
+	for (BurnStateEntry* pEntry = pStateEntryAnchor; pEntry; pEntry = pEntry->pNext) {
+		BurnStateArea* pLast = nStateTableLen ? &pStateTable[nStateTableLen - 1] : NULL;
+
+		if (pLast && (UINT8*)pLast->pValue + pLast->nSize == (UINT8*)pEntry->pValue) {
+			pLast->nSize += pEntry->nSize;
+			continue;
+		}
+
+		pStateTable[nStateTableLen].pValue = pEntry->pValue;
+		pStateTable[nStateTableLen].nSize  = pEntry->nSize;
+		pStateTable[nStateTableLen].szName = pEntry->szName;
+		nStateTableLen++;
+	}
+}
+
 static INT32 BurnStateMAMEScan(INT32 nAction, INT32* pnMin)
 {
 	if (nAction & ACB_VOLATILE)
@@ -689,7 +744,22 @@ static INT32 BurnStateMAMEScan(INT32 nAction, INT32* pnMin)
 		if (pnMin && *pnMin < 0x029418) // Return minimum compatible version
 			*pnMin = 0x029418;
 
-		if (pStateEntryAnchor)
+		if (pStateEntryAnchor && pStateTable == NULL)
+			BurnStateTableInit();
+
+		if (pStateTable)
+      {
+         struct BurnArea ba;
+
+         for (INT32 i = 0; i < nStateTableLen; i++) {
+            ba.Data		= pStateTable[i].pValue;
+            ba.nLen		= pStateTable[i].nSize;
+            ba.nAddress = 0;
+            ba.szName	= pStateTable[i].szName;
+            BurnAcb(&ba);
+         }
+      }
+		else if (pStateEntryAnchor)
       {
          struct BurnArea ba;
          BurnStateEntry* pCurrentEntry = pStateEntryAnchor;
@@ -750,6 +820,8 @@ static void BurnStateRegister(const char* module, INT32 instance, const char* na
 
 	pNewEntry->pValue = val;
 	pNewEntry->nSize = size;
+
+	BurnStateTableExit();
 }
 
 void BurnStateExit(void)
@@ -768,6 +840,8 @@ void BurnStateExit(void)
 
 	pStateEntryAnchor = NULL;
 
+	BurnStateTableExit();
+
 	for (INT32 i = 0; i < 8; i++)
 		BurnPostload[i] = NULL;
 }
@@ -53,6 +53,19 @@ enum BurnCartrigeCommand { CART_INIT_START, CART_INIT_END, CART_EXIT };
 // Application-defined rom loading function
 extern INT32 (__cdecl *BurnExtLoadRom)(UINT8* Dest, INT32* pnWrote, INT32 i);
 
+// Optional application-defined rom loading function that hands the rom to pChunk a block at a time,
+// in order. pChunk returns non-zero to abort the load
+typedef INT32 (*BurnLoadRomChunk)(UINT8* pData, INT32 nOffset, INT32 nLen, void* pParam);
+extern INT32 (__cdecl *BurnExtLoadRomChunked)(INT32 i, INT32* pnWrote, BurnLoadRomChunk pChunk, void* pParam);
+
+// Optional application-defined function that reports a rom stored uncompressed in its archive: the archive's
+// path goes in pszFile and the position of the rom's data in pnOffset. Returns non-zero if it can't be mapped
+extern INT32 (__cdecl *BurnExtFindStoredRom)(INT32 i, char* pszFile, INT32 nFileLen, INT64* pnOffset);
+
+// Optional application-defined function that reports the CRC of the file actually found for a rom, which
+// may differ from the one the driver lists. Returns non-zero if the rom wasn't found
+extern INT32 (__cdecl *BurnExtGetRomCrc)(INT32 i, UINT32* pnCrc);
+
 // Application-defined progress indicator functions
 extern INT32 (__cdecl *BurnExtProgressRangeCallback)(double dProgressRange);
 extern INT32 (__cdecl *BurnExtProgressUpdateCallback)(double dProgress, const TCHAR* pszText, bool bAbs);
@@ -150,6 +163,9 @@ extern INT32 nBurnBpp;						// Bytes per pixel (2, 3, or 4)
 extern UINT8 nBurnLayer;			// Can be used externally to select which layers to show
 extern UINT8 nSpriteEnable;			// Can be used externally to select which Sprites to show
 extern UINT8 nSkipFrame;			// Can be used to skip rendering of the current frame
+extern bool bBurnNoRender;			// Can be used to skip rendering and sound synthesis altogether
+extern UINT32 nBurnNVRAMChanges;	// Bumped by drivers whenever they change battery backed memory
+extern INT64 nBurnClockTime;		// If not 0, the time (in seconds since 1970, UTC) real-time clocks start from instead of the host's
 
 extern INT32 nBurnSoundRate;					// Samplerate of sound
 extern INT32 nBurnSoundLen;					// Length in samples per frame
@@ -179,6 +195,17 @@ INT32 BurnUpdateProgress(double dProgressStep, const TCHAR* pszText, bool bAbs);
 
 void BurnLocalisationSetName(char *szName, TCHAR *szLongName);
 
+// burn_memory.cpp
+void BurnGetMemoryUsage(UINT64* pnCurrent, UINT64* pnPeak);
+
+// burn_thread.cpp
+typedef void (*BurnThreadJob)(INT32 nIndex, void* pParam);
+INT32 BurnThreadCount();
+void BurnThreadRun(BurnThreadJob pJob, void* pParam, INT32 nCount);
+struct BurnThreadTask* BurnThreadStart(BurnThreadJob pJob, void* pParam);
+INT32 BurnThreadDone(struct BurnThreadTask* pTask);
+void BurnThreadWait(struct BurnThreadTask* pTask);
+
 // ---------------------------------------------------------------------------
 // Retrieve driver information
 
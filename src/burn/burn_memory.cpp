@@ -6,54 +6,190 @@
 
 #include "burnint.h"
 
+#if defined(__linux__)
+ #include <sys/mman.h>
+ #if defined(MADV_HUGEPAGE)
+  #define BURN_MEMORY_HUGEPAGES
+ #endif
+#endif
+
 #define MAX_MEM_PTR	0x400 // more than 1024 malloc calls should be insane...
+#define MEM_HASH_SIZE	(MAX_MEM_PTR * 2) // power of two, never more than half full
+
+// Blocks this large get their own 2MB aligned mapping, which the kernel is asked to back with
+// huge pages. The sprite and ADPCM ROMs are read all over every frame, so fewer TLB misses help
+#define MEM_HUGE_MIN	(0x200000)
+#define MEM_HUGE_ALIGN	(0x200000)
+
+struct BurnMemBlock {
+	UINT8 *pData;
+	size_t nLen;
+	void *pMap; // whole mapping of a huge page block, NULL if pData came from calloc()
+	size_t nMapLen;
+};
+
+static BurnMemBlock memblock[MAX_MEM_PTR]; // allocated memory
+
+// Unused entries of memblock[], and a pointer -> entry hash (linear probing, -1 is empty), so
+// neither BurnMalloc() nor BurnFree() has to search the table
+static INT16 nFreeBlock[MAX_MEM_PTR];
+static INT32 nFreeBlocks = 0;
+static INT16 nMemHash[MEM_HASH_SIZE];
+static bool bMemInit = false;
+
+static size_t nMemUsed = 0;
+static size_t nMemPeak = 0;
+
+static INT32 MemHashHome(const void *ptr)
+{
+	return (INT32)((((size_t)ptr >> 4) * 0x9E3779B1) & (MEM_HASH_SIZE - 1));
+}
+
+static INT32 MemHashFind(const void *ptr)
+{
+	for (INT32 nPos = MemHashHome(ptr); nMemHash[nPos] >= 0; nPos = (nPos + 1) & (MEM_HASH_SIZE - 1)) {
+		if (memblock[nMemHash[nPos]].pData == ptr) {
+			return nPos;
+		}
+	}
+
+	return -1;
+}
+
+static void MemHashInsert(INT32 nBlock)
+{
+	INT32 nPos = MemHashHome(memblock[nBlock].pData);
+
+	while (nMemHash[nPos] >= 0) {
+		nPos = (nPos + 1) & (MEM_HASH_SIZE - 1);
+	}
+
+	nMemHash[nPos] = nBlock;
+}
+
+// Empty a slot and move later entries of the same run back into it, so lookups never stop short
+static void MemHashRemove(INT32 nPos)
+{
+	INT32 nNext = nPos;
+
+	nMemHash[nPos] = -1;
+
+	while (1) {
+		nNext = (nNext + 1) & (MEM_HASH_SIZE - 1);
+		if (nMemHash[nNext] < 0) {
+			break;
+		}
+
+		INT32 nHome = MemHashHome(memblock[nMemHash[nNext]].pData);
+		if (((nNext - nHome) & (MEM_HASH_SIZE - 1)) >= ((nNext - nPos) & (MEM_HASH_SIZE - 1))) {
+			nMemHash[nPos] = nMemHash[nNext];
+			nMemHash[nNext] = -1;
+			nPos = nNext;
+		}
+	}
+}
+
+static void MemBlockRelease(BurnMemBlock *pBlock)
+{
+#if defined BURN_MEMORY_HUGEPAGES
+	if (pBlock->pMap) {
+		munmap(pBlock->pMap, pBlock->nMapLen);
+	} else
+#endif
+	{
+		free(pBlock->pData);
+	}
+
+	nMemUsed -= pBlock->nLen;
 
-static UINT8 *memptr[MAX_MEM_PTR]; // pointer to allocated memory
+	memset(pBlock, 0, sizeof(BurnMemBlock));
+}
 
 // this should be called early on... BurnDrvInit?
 
 void BurnInitMemoryManager()
 {
-	memset (memptr, 0, MAX_MEM_PTR * sizeof(UINT8 **));	
+	memset (memblock, 0, sizeof(memblock));
+	memset (nMemHash, 0xFF, sizeof(nMemHash));
+
+	for (INT32 i = 0; i < MAX_MEM_PTR; i++) {
+		nFreeBlock[i] = MAX_MEM_PTR - 1 - i;
+	}
+	nFreeBlocks = MAX_MEM_PTR;
+
+	nMemUsed = 0;
+	nMemPeak = 0;
+
+	bMemInit = true;
 }
 
 // should we pass the pointer as a variable here so that we can save a pointer to it
 // and then ensure it is NULL'd in BurnFree or BurnExitMemoryManager?
 
 // call instead of 'malloc'
-UINT8 *BurnMalloc(INT32 size)
+UINT8 *BurnMalloc(size_t size)
 {
-	for (INT32 i = 0; i < MAX_MEM_PTR; i++)
-	{
-		if (memptr[i] == NULL) {
-			memptr[i] = (UINT8*)malloc(size);
+	if (!bMemInit) {
+		BurnInitMemoryManager();
+	}
+
+	if (nFreeBlocks == 0) {
+		return NULL; // Freak out!
+	}
+
+	BurnMemBlock *pBlock = &memblock[nFreeBlock[nFreeBlocks - 1]];
 
-			if (memptr[i] == NULL)
-				return NULL;
+#if defined BURN_MEMORY_HUGEPAGES
+	if (size >= MEM_HUGE_MIN) {
+		size_t nMapLen = size + MEM_HUGE_ALIGN;
+		void *pMap = mmap(NULL, nMapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-			memset (memptr[i], 0, size); // set contents to 0
+		if (pMap != MAP_FAILED) {
+			pBlock->pData = (UINT8*)(((size_t)pMap + MEM_HUGE_ALIGN - 1) & ~(size_t)(MEM_HUGE_ALIGN - 1));
+			pBlock->pMap = pMap;
+			pBlock->nMapLen = nMapLen;
 
-			return memptr[i];
+			madvise(pBlock->pData, size, MADV_HUGEPAGE);
 		}
 	}
+#endif
+
+	// Fresh anonymous mappings are zero filled already, and so is calloc()ed memory
+	if (pBlock->pData == NULL) {
+		pBlock->pData = (UINT8*)calloc(1, size);
+
+		if (pBlock->pData == NULL)
+			return NULL;
+	}
+
+	pBlock->nLen = size;
+
+	MemHashInsert(nFreeBlock[--nFreeBlocks]);
+
+	nMemUsed += size;
+	if (nMemUsed > nMemPeak) {
+		nMemPeak = nMemUsed;
+	}
 
-	return NULL; // Freak out!
+	return pBlock->pData;
 }
 
 // call instead of "free"
 void _BurnFree(void *ptr)
 {
-	UINT8 *mptr = (UINT8*)ptr;
+	// Pointers BurnMalloc() didn't return (e.g. regions mapped from a file) are left alone
+	INT32 nPos = (ptr && bMemInit) ? MemHashFind(ptr) : -1;
 
-	for (INT32 i = 0; i < MAX_MEM_PTR; i++)
-	{
-		if (memptr[i] == mptr) {
-			free (memptr[i]);
-			memptr[i] = NULL;
-
-			break;
-		}
+	if (nPos < 0) {
+		return;
 	}
+
+	INT32 nBlock = nMemHash[nPos];
+
+	MemHashRemove(nPos);
+	MemBlockRelease(&memblock[nBlock]);
+
+	nFreeBlock[nFreeBlocks++] = nBlock;
 }
 
 // call in BurnDrvExit?
@@ -62,10 +198,23 @@ void BurnExitMemoryManager()
 {
 	for (INT32 i = 0; i < MAX_MEM_PTR; i++)
 	{
-		if (memptr[i] != NULL)
+		if (memblock[i].pData != NULL)
       {
-			free (memptr[i]);
-			memptr[i] = NULL;
+			MemBlockRelease(&memblock[i]);
 		}
 	}
+
+	memset (nMemHash, 0xFF, sizeof(nMemHash));
+
+	for (INT32 i = 0; i < MAX_MEM_PTR; i++) {
+		nFreeBlock[i] = MAX_MEM_PTR - 1 - i;
+	}
+	nFreeBlocks = MAX_MEM_PTR;
+}
+
+// Bytes currently allocated with BurnMalloc(), and the most there were at any time since the driver was initialised
+void BurnGetMemoryUsage(UINT64 *pnCurrent, UINT64 *pnPeak)
+{
+	if (pnCurrent) *pnCurrent = nMemUsed;
+	if (pnPeak) *pnPeak = nMemPeak;
 }
@@ -0,0 +1,280 @@
+// FB Alpha worker threads
+
+// Runs a batch of independent jobs (e.g. decrypting one ROM block each) on
+// all available CPUs and returns once every job has finished. The calling
+// thread takes part in the work. Without HAVE_THREADS, or with a single CPU,
+// the jobs simply run in order on the calling thread.
+//
+// A single job can also be started in the background with BurnThreadStart(),
+// which returns at once, and collected later with BurnThreadWait().
+// BurnThreadDone() tells whether that would still block.
+
+#include "burnint.h"
+
+#if defined HAVE_THREADS
+ #if defined _WIN32
+  #include <windows.h>
+ #else
+  #include <pthread.h>
+  #include <unistd.h>
+ #endif
+#endif
+
+#define BURN_THREAD_MAX		(16)
+
+#if defined HAVE_THREADS
+
+struct BurnThreadBatch {
+	BurnThreadJob pJob;
+	void* pParam;
+	INT32 nCount;
+	INT32 nNext;
+#if defined _WIN32
+	CRITICAL_SECTION Lock;
+#else
+	pthread_mutex_t Lock;
+#endif
+};
+
+static INT32 BurnThreadNextJob(BurnThreadBatch* pBatch)
+{
+	INT32 nJob;
+
+#if defined _WIN32
+	EnterCriticalSection(&pBatch->Lock);
+	nJob = pBatch->nNext++;
+	LeaveCriticalSection(&pBatch->Lock);
+#else
+	pthread_mutex_lock(&pBatch->Lock);
+	nJob = pBatch->nNext++;
+	pthread_mutex_unlock(&pBatch->Lock);
+#endif
+
+	return nJob;
+}
+
+static void BurnThreadWork(BurnThreadBatch* pBatch)
+{
+	INT32 nJob;
+
+	while ((nJob = BurnThreadNextJob(pBatch)) < pBatch->nCount) {
+		pBatch->pJob(nJob, pBatch->pParam);
+	}
+}
+
+#if defined _WIN32
+static DWORD WINAPI BurnThreadEntry(LPVOID pArg)
+{
+	BurnThreadWork((BurnThreadBatch*)pArg);
+	return 0;
+}
+#else
+static void* BurnThreadEntry(void* pArg)
+{
+	BurnThreadWork((BurnThreadBatch*)pArg);
+	return NULL;
+}
+#endif
+
+#endif
+
+INT32 BurnThreadCount()
+{
+	INT32 nThreads = 1;
+
+#if defined HAVE_THREADS
+ #if defined _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	nThreads = si.dwNumberOfProcessors;
+ #elif defined _SC_NPROCESSORS_ONLN
+	nThreads = sysconf(_SC_NPROCESSORS_ONLN);
+ #endif
+#endif
+
+	if (nThreads < 1) {
+		nThreads = 1;
+	}
+	if (nThreads > BURN_THREAD_MAX) {
+		nThreads = BURN_THREAD_MAX;
+	}
+
+	return nThreads;
+}
+
+void BurnThreadRun(BurnThreadJob pJob, void* pParam, INT32 nCount)
+{
+	INT32 nThreads = BurnThreadCount();
+
+	if (nThreads > nCount) {
+		nThreads = nCount;
+	}
+
+#if defined HAVE_THREADS
+	if (nThreads > 1) {
+		BurnThreadBatch Batch;
+		INT32 nStarted = 0;
+#if defined _WIN32
+		HANDLE hThread[BURN_THREAD_MAX];
+#else
+		pthread_t hThread[BURN_THREAD_MAX];
+#endif
+
+		Batch.pJob   = pJob;
+		Batch.pParam = pParam;
+		Batch.nCount = nCount;
+		Batch.nNext  = 0;
+
+#if defined _WIN32
+		InitializeCriticalSection(&Batch.Lock);
+#else
+		pthread_mutex_init(&Batch.Lock, NULL);
+#endif
+
+		// If a thread can't be created the remaining ones (and this one) pick up its share
+		for (INT32 i = 0; i < nThreads - 1; i++) {
+#if defined _WIN32
+			hThread[nStarted] = CreateThread(NULL, 0, BurnThreadEntry, &Batch, 0, NULL);
+			if (hThread[nStarted] != NULL) {
+				nStarted++;
+			}
+#else
+			if (pthread_create(&hThread[nStarted], NULL, BurnThreadEntry, &Batch) == 0) {
+				nStarted++;
+			}
+#endif
+		}
+
+		BurnThreadWork(&Batch);
+
+		for (INT32 i = 0; i < nStarted; i++) {
+#if defined _WIN32
+			WaitForSingleObject(hThread[i], INFINITE);
+			CloseHandle(hThread[i]);
+#else
+			pthread_join(hThread[i], NULL);
+#endif
+		}
+
+#if defined _WIN32
+		DeleteCriticalSection(&Batch.Lock);
+#else
+		pthread_mutex_destroy(&Batch.Lock);
+#endif
+
+		return;
+	}
+#endif
+
+	for (INT32 i = 0; i < nCount; i++) {
+		pJob(i, pParam);
+	}
+}
+
+struct BurnThreadTask {
+	BurnThreadJob pJob;
+	void* pParam;
+#if defined HAVE_THREADS
+ #if defined _WIN32
+	HANDLE hThread;
+ #else
+	pthread_t hThread;
+	INT32 bDone;
+ #endif
+#endif
+};
+
+#if defined HAVE_THREADS
+#if defined _WIN32
+static DWORD WINAPI BurnThreadTaskEntry(LPVOID pArg)
+{
+	BurnThreadTask* pTask = (BurnThreadTask*)pArg;
+	pTask->pJob(0, pTask->pParam);
+	return 0;
+}
+#else
+static void* BurnThreadTaskEntry(void* pArg)
+{
+	BurnThreadTask* pTask = (BurnThreadTask*)pArg;
+	pTask->pJob(0, pTask->pParam);
+	__atomic_store_n(&pTask->bDone, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+#endif
+#endif
+
+// Run pJob(0, pParam) on a thread of its own. If no thread can be started the job is run before
+// this returns. Either way the task must be passed to BurnThreadWait() once
+BurnThreadTask* BurnThreadStart(BurnThreadJob pJob, void* pParam)
+{
+	BurnThreadTask* pTask = (BurnThreadTask*)malloc(sizeof(BurnThreadTask));
+
+	if (pTask == NULL) {
+		pJob(0, pParam);
+		return NULL;
+	}
+
+	pTask->pJob = pJob;
+	pTask->pParam = pParam;
+
+#if defined HAVE_THREADS
+ #if defined _WIN32
+	pTask->hThread = CreateThread(NULL, 0, BurnThreadTaskEntry, pTask, 0, NULL);
+	if (pTask->hThread != NULL) {
+		return pTask;
+	}
+ #else
+	pTask->bDone = 0;
+	if (pthread_create(&pTask->hThread, NULL, BurnThreadTaskEntry, pTask) == 0) {
+		return pTask;
+	}
+ #endif
+#endif
+
+	pJob(0, pParam);
+
+	pTask->pJob = NULL;
+
+	return pTask;
+}
+
+// Returns nonzero once a task has finished, so BurnThreadWait() won't block
+INT32 BurnThreadDone(BurnThreadTask* pTask)
+{
+	if (pTask == NULL) {
+		return 1;
+	}
+
+#if defined HAVE_THREADS
+	if (pTask->pJob) {
+ #if defined _WIN32
+		return (WaitForSingleObject(pTask->hThread, 0) == WAIT_OBJECT_0) ? 1 : 0;
+ #else
+		return __atomic_load_n(&pTask->bDone, __ATOMIC_ACQUIRE);
+ #endif
+	}
+#endif
+
+	return 1;
+}
+
+// Wait for a task to finish and free it
+void BurnThreadWait(BurnThreadTask* pTask)
+{
+	if (pTask == NULL) {
+		return;
+	}
+
+#if defined HAVE_THREADS
+	if (pTask->pJob) {
+ #if defined _WIN32
+		WaitForSingleObject(pTask->hThread, INFINITE);
+		CloseHandle(pTask->hThread);
+ #else
+		pthread_join(pTask->hThread, NULL);
+ #endif
+	}
+#endif
+
+	free(pTask);
+}
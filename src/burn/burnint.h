@@ -108,6 +108,8 @@ INT32 BurnByteswap(UINT8* pm,INT32 nLen);
 
 // load.cpp
 INT32 BurnLoadRom(UINT8* Dest, INT32 i, INT32 nGap);
+UINT8* BurnMapRom(INT32 i);
+void BurnUnmapRoms();
 
 // ---------------------------------------------------------------------------
 // Setting up cpus for cheats
@@ -134,7 +136,7 @@ void CpuCheatRegister(INT32 type, cpu_core_config *config);
 
 // burn_memory.cpp
 void BurnInitMemoryManager();
-UINT8 *BurnMalloc(INT32 size);
+UINT8 *BurnMalloc(size_t size);
 void _BurnFree(void *ptr);
 #define BurnFree(x)		_BurnFree(x); x = NULL;
 void BurnExitMemoryManager();
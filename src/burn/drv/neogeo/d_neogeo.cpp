@@ -5826,7 +5826,7 @@ static INT32 mslugxInit()
 
 static INT32 mslugxScan(INT32 nAction, INT32 *pnMin)
 {
-	if (pnMin) {
+	if (pnMin && *pnMin < 0x029727) {
 		*pnMin =  0x029727;
 	}
 
@@ -7601,7 +7601,7 @@ static INT32 kof10thScan(INT32 nAction, INT32* pnMin)
 {
 	struct BurnArea ba;
 	
-	if (pnMin) {												// Return minimum compatible version
+	if (pnMin && *pnMin < 0x029713) {							// Return minimum compatible version
 		*pnMin =  0x029713;
 	}
 
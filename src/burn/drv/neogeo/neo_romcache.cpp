@@ -0,0 +1,531 @@
+// Neo Geo pre-decoded ROM cache
+//
+// Loading a large cartridge means inflating every ROM, running the CMC and
+// per-game decryption and converting the sprite bitplanes. The result only
+// depends on the ROM set, so once built it is written out as one file per
+// driver and read back on the next start instead. Where mmap() is available
+// the regions are mapped copy-on-write, so untouched sprite and ADPCM data is
+// only paged in when the game actually uses it.
+//
+// The cache is keyed by driver name, hardware code and the name, length,
+// type and CRC of every ROM in the set. The CRCs are those of the files
+// actually found (BurnExtGetRomCrc), so a replaced ROM builds a new cache.
+// Bump NEO_ROM_CACHE_VERSION whenever the decoders change their output.
+//
+// With bNeoROMCacheShared set the same layout is published to a named POSIX
+// shared memory object instead of a file. Every instance of the emulator
+// running the same ROM set maps the one copy, so hosting many instances costs
+// memory per game rather than per instance. The object outlives the process
+// that created it, until it is removed from /dev/shm or the machine restarts.
+// Objects are private to the user that created them (the user is part of the
+// name, and objects owned by anyone else are ignored), and one that is still
+// incomplete NEO_ROM_CACHE_STALE seconds after it was last written was left
+// behind by an instance that died while publishing it, and is removed.
+
+#include <stdio.h>
+#include <time.h>
+#include "neogeo.h"
+
+#if defined NEO_ROM_CACHE
+
+#if defined(__unix__) || defined(__APPLE__)
+ #define NEO_ROM_CACHE_MMAP
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+ #if defined HAVE_SHM
+  #define NEO_ROM_CACHE_SHM
+ #endif
+#endif
+
+#define NEO_ROM_CACHE_MAGIC		"NRC1"
+#define NEO_ROM_CACHE_VERSION	(1)
+#define NEO_ROM_CACHE_ALIGN		(0x10000)					// Covers 4KB, 16KB and 64KB pages
+
+char szNeoROMCachePath[1024] = "";
+bool bNeoROMCacheShared = false;
+
+struct NeoROMCacheHeader {
+	char	szMagic[4];
+	UINT32	nVersion;
+	UINT32	nByteOrder;
+	UINT32	nRegions;
+	UINT64	nKey;
+	UINT32	nOffset[NEO_CACHE_REGIONS];
+	UINT32	nLen[NEO_CACHE_REGIONS];
+};
+
+static NeoROMCacheHeader CacheHeader[MAX_SLOT];
+static bool bCacheValid[MAX_SLOT] = { false, };
+static char szCacheName[MAX_SLOT][1024];
+
+#if defined NEO_ROM_CACHE_MMAP
+// Mapped regions are not known to BurnFree(), they are unmapped in NeoROMCacheExit()
+struct NeoROMCacheMapping {
+	void* pData;
+	UINT32 nLen;
+};
+
+static NeoROMCacheMapping CacheMapping[MAX_SLOT * NEO_CACHE_REGIONS];
+static INT32 nCacheMappings = 0;
+#endif
+
+static UINT64 CacheHash(UINT64 nHash, const void* pData, UINT32 nLen)
+{
+	const UINT8* p = (const UINT8*)pData;
+
+	// FNV-1a
+	while (nLen--) {
+		nHash ^= *p++;
+		nHash *= 0x100000001B3ULL;
+	}
+
+	return nHash;
+}
+
+static UINT64 CacheKey()
+{
+	UINT64 nKey = 0xCBF29CE484222325ULL;
+	UINT32 nValue;
+	const char* pszDrvName = BurnDrvGetTextA(DRV_NAME);
+
+	nValue = NEO_ROM_CACHE_VERSION;
+	nKey = CacheHash(nKey, &nValue, sizeof(nValue));
+	nKey = CacheHash(nKey, pszDrvName, strlen(pszDrvName));
+	nValue = BurnDrvGetHardwareCode();
+	nKey = CacheHash(nKey, &nValue, sizeof(nValue));
+
+	for (INT32 i = 0; i < 0x80; i++) {
+		struct BurnRomInfo ri;
+		char* pszName = NULL;
+
+		if (BurnDrvGetRomInfo(&ri, i) || BurnDrvGetRomName(&pszName, i, 0)) {
+			break;
+		}
+
+		if (pszName) {
+			nKey = CacheHash(nKey, pszName, strlen(pszName));
+		}
+		if (BurnExtGetRomCrc) {
+			UINT32 nCrc;
+
+			if (BurnExtGetRomCrc(i, &nCrc) == 0) {
+				ri.nCrc = nCrc;
+			}
+		}
+		nKey = CacheHash(nKey, &ri.nLen, sizeof(ri.nLen));
+		nKey = CacheHash(nKey, &ri.nCrc, sizeof(ri.nCrc));
+		nKey = CacheHash(nKey, &ri.nType, sizeof(ri.nType));
+	}
+
+	return nKey;
+}
+
+static void CacheHeaderInit(NeoROMCacheHeader* pHeader)
+{
+	memset(pHeader, 0, sizeof(NeoROMCacheHeader));
+	memcpy(pHeader->szMagic, NEO_ROM_CACHE_MAGIC, 4);
+	pHeader->nVersion   = NEO_ROM_CACHE_VERSION;
+	pHeader->nByteOrder = 0x01020304;
+	pHeader->nRegions   = NEO_CACHE_REGIONS;
+	pHeader->nKey       = CacheKey();
+}
+
+static bool CacheHeaderMatch(const NeoROMCacheHeader* pHeader)
+{
+	NeoROMCacheHeader Expected;
+
+	CacheHeaderInit(&Expected);
+
+	return !(memcmp(pHeader->szMagic, Expected.szMagic, 4) || pHeader->nVersion != Expected.nVersion || pHeader->nByteOrder != Expected.nByteOrder || pHeader->nRegions != Expected.nRegions || pHeader->nKey != Expected.nKey);
+}
+
+// Give every region an aligned offset (regions with a NULL pointer or zero length are skipped), returns the total size
+static UINT32 CacheLayout(NeoROMCacheHeader* pHeader, UINT8** pRegion, UINT32* nRegionLen)
+{
+	UINT32 nOffset = NEO_ROM_CACHE_ALIGN;
+
+	for (INT32 i = 0; i < NEO_CACHE_REGIONS; i++) {
+		if (pRegion[i] == NULL || nRegionLen[i] == 0) {
+			continue;
+		}
+		pHeader->nOffset[i] = nOffset;
+		pHeader->nLen[i]    = nRegionLen[i];
+		nOffset += (nRegionLen[i] + NEO_ROM_CACHE_ALIGN - 1) & ~(NEO_ROM_CACHE_ALIGN - 1);
+	}
+
+	return nOffset;
+}
+
+bool NeoROMCacheEnabled()
+{
+#if defined NEO_ROM_CACHE_SHM
+	if (bNeoROMCacheShared) {
+		return true;
+	}
+#endif
+
+	return szNeoROMCachePath[0] != '\0';
+}
+
+#if defined NEO_ROM_CACHE_SHM
+#define NEO_ROM_CACHE_STALE		(120)
+
+// The name only has room for the key (macOS allows 31 characters), which covers the driver name and the user as well
+static void SharedName(INT32 nSlot)
+{
+	UINT32 nUser = geteuid();
+
+	snprintf(szCacheName[nSlot], sizeof(szCacheName[nSlot]), "/fbaneo-%016llx", (unsigned long long)CacheHash(CacheKey(), &nUser, sizeof(nUser)));
+}
+
+// Remove an object without a valid header once whoever was publishing it has clearly given up
+static void SharedReclaim(INT32 nSlot, const struct stat* pStat)
+{
+	if (time(NULL) - pStat->st_mtime > NEO_ROM_CACHE_STALE) {
+		shm_unlink(szCacheName[nSlot]);
+	}
+}
+
+static INT32 SharedOpen(INT32 nSlot)
+{
+	struct stat st;
+	void* p;
+	INT32 fd;
+
+	SharedName(nSlot);
+
+	fd = shm_open(szCacheName[nSlot], O_RDONLY, 0);
+	if (fd < 0) {
+		return 1;
+	}
+
+	// The code in the cache is run as is, so only trust what this user published
+	if (fstat(fd, &st) != 0 || st.st_uid != geteuid()) {
+		close(fd);
+		return 1;
+	}
+
+	if (st.st_size < (off_t)sizeof(NeoROMCacheHeader)) {
+		close(fd);
+		SharedReclaim(nSlot, &st);
+		return 1;
+	}
+
+	// Shared memory objects can't be read() everywhere, only mapped
+	p = mmap(NULL, sizeof(NeoROMCacheHeader), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return 1;
+	}
+
+	memcpy(&CacheHeader[nSlot], p, sizeof(NeoROMCacheHeader));
+	munmap(p, sizeof(NeoROMCacheHeader));
+
+	if (!CacheHeaderMatch(&CacheHeader[nSlot])) {
+		SharedReclaim(nSlot, &st);
+		return 1;
+	}
+
+	for (INT32 i = 0; i < NEO_CACHE_REGIONS; i++) {
+		if ((off_t)CacheHeader[nSlot].nOffset[i] + CacheHeader[nSlot].nLen[i] > st.st_size) {
+			SharedReclaim(nSlot, &st);
+			return 1;
+		}
+	}
+
+	bCacheValid[nSlot] = true;
+
+	return 0;
+}
+
+static INT32 SharedSave(INT32 nSlot, UINT8** pRegion, UINT32* nRegionLen)
+{
+	NeoROMCacheHeader Header;
+	UINT32 nSize;
+	UINT8* p;
+	INT32 fd;
+
+	CacheHeaderInit(&Header);
+	nSize = CacheLayout(&Header, pRegion, nRegionLen);
+
+	SharedName(nSlot);
+
+	// If the object exists another instance has published (or is publishing) this ROM set already
+	fd = shm_open(szCacheName[nSlot], O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return 1;
+	}
+
+	if (ftruncate(fd, nSize) != 0) {
+		close(fd);
+		shm_unlink(szCacheName[nSlot]);
+		return 1;
+	}
+
+	p = (UINT8*)mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == (UINT8*)MAP_FAILED) {
+		shm_unlink(szCacheName[nSlot]);
+		return 1;
+	}
+
+	for (INT32 i = 0; i < NEO_CACHE_REGIONS; i++) {
+		if (Header.nLen[i]) {
+			memcpy(p + Header.nOffset[i], pRegion[i], Header.nLen[i]);
+		}
+	}
+
+	// The magic goes in last, until then other instances see an incomplete object and decode the ROMs themselves
+	memcpy(p + 4, (UINT8*)&Header + 4, sizeof(Header) - 4);
+	__sync_synchronize();
+	memcpy(p, Header.szMagic, 4);
+
+	munmap(p, nSize);
+
+	return 0;
+}
+#endif
+
+// Fails if there is no cache directory or the name doesn't fit
+static INT32 CacheFileName(INT32 nSlot)
+{
+	if (szNeoROMCachePath[0] == '\0') {
+		return 1;
+	}
+
+	return snprintf(szCacheName[nSlot], sizeof(szCacheName[nSlot]), "%s%s.nrc", szNeoROMCachePath, BurnDrvGetTextA(DRV_NAME)) >= (INT32)sizeof(szCacheName[nSlot]);
+}
+
+// Get a descriptor of the cache for mmap()
+#if defined NEO_ROM_CACHE_MMAP
+static INT32 CacheOpenFd(INT32 nSlot)
+{
+#if defined NEO_ROM_CACHE_SHM
+	if (bNeoROMCacheShared) {
+		return shm_open(szCacheName[nSlot], O_RDONLY, 0);
+	}
+#endif
+
+	return open(szCacheName[nSlot], O_RDONLY);
+}
+#endif
+
+// Returns 0 if a cache matching the current driver's ROM set exists
+INT32 NeoROMCacheOpen(INT32 nSlot)
+{
+	FILE* fp;
+
+	bCacheValid[nSlot] = false;
+
+#if defined NEO_ROM_CACHE_SHM
+	if (bNeoROMCacheShared) {
+		return SharedOpen(nSlot);
+	}
+#endif
+
+	if (CacheFileName(nSlot)) {
+		return 1;
+	}
+
+	fp = fopen(szCacheName[nSlot], "rb");
+	if (fp == NULL) {
+		return 1;
+	}
+
+	if (fread(&CacheHeader[nSlot], sizeof(NeoROMCacheHeader), 1, fp) != 1 || fseek(fp, 0, SEEK_END)) {
+		fclose(fp);
+		return 1;
+	}
+	long nSize = ftell(fp);
+	fclose(fp);
+
+	if (!CacheHeaderMatch(&CacheHeader[nSlot])) {
+		return 1;
+	}
+
+	// A file cut short after it was written would fault when a mapped region is touched
+	for (INT32 i = 0; i < NEO_CACHE_REGIONS; i++) {
+		if ((INT64)CacheHeader[nSlot].nOffset[i] + CacheHeader[nSlot].nLen[i] > (INT64)nSize) {
+			return 1;
+		}
+	}
+
+	bCacheValid[nSlot] = true;
+
+	return 0;
+}
+
+// Returns the cached contents of a region, or NULL if the region is missing or has a different length
+UINT8* NeoROMCacheLoad(INT32 nSlot, INT32 nRegion, UINT32 nLen)
+{
+	UINT8* pData = NULL;
+	FILE* fp;
+
+	if (!bCacheValid[nSlot] || nRegion < 0 || nRegion >= NEO_CACHE_REGIONS || nLen == 0) {
+		return NULL;
+	}
+	if (CacheHeader[nSlot].nLen[nRegion] != nLen) {
+		return NULL;
+	}
+
+#if defined NEO_ROM_CACHE_MMAP
+	if (nCacheMappings < MAX_SLOT * NEO_CACHE_REGIONS) {
+		INT32 fd = CacheOpenFd(nSlot);
+
+		if (fd >= 0) {
+			// Private mapping: drivers that patch their ROMs after loading get their own copy of the page
+			void* p = mmap(NULL, nLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, CacheHeader[nSlot].nOffset[nRegion]);
+			close(fd);
+
+			if (p != MAP_FAILED) {
+				CacheMapping[nCacheMappings].pData = p;
+				CacheMapping[nCacheMappings].nLen  = nLen;
+				nCacheMappings++;
+
+				return (UINT8*)p;
+			}
+		}
+	}
+#endif
+
+#if defined NEO_ROM_CACHE_SHM
+	if (bNeoROMCacheShared) {
+		return NULL;
+	}
+#endif
+
+	// Plain read into memory the caller owns and releases with BurnFree()
+	fp = fopen(szCacheName[nSlot], "rb");
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	pData = (UINT8*)BurnMalloc(nLen);
+	if (pData == NULL || fseek(fp, CacheHeader[nSlot].nOffset[nRegion], SEEK_SET) || fread(pData, 1, nLen, fp) != nLen) {
+		fclose(fp);
+		BurnFree(pData);
+		return NULL;
+	}
+	fclose(fp);
+
+	return pData;
+}
+
+// Write the decoded regions of the current driver. Regions with a NULL pointer or zero length are skipped
+INT32 NeoROMCacheSave(INT32 nSlot, UINT8** pRegion, UINT32* nRegionLen)
+{
+	static const UINT8 Padding[0x1000] = { 0, };
+	NeoROMCacheHeader Header;
+	char szTempName[1024 + 4];
+	FILE* fp;
+
+#if defined NEO_ROM_CACHE_SHM
+	if (bNeoROMCacheShared) {
+		return SharedSave(nSlot, pRegion, nRegionLen);
+	}
+#endif
+
+	if (CacheFileName(nSlot)) {
+		return 1;
+	}
+	if (snprintf(szTempName, sizeof(szTempName), "%s.tmp", szCacheName[nSlot]) >= (INT32)sizeof(szTempName)) {
+		return 1;
+	}
+
+	CacheHeaderInit(&Header);
+	CacheLayout(&Header, pRegion, nRegionLen);
+
+	// Written under a temporary name so an interrupted write never leaves a valid looking cache behind
+	fp = fopen(szTempName, "wb");
+	if (fp == NULL) {
+		return 1;
+	}
+
+	INT32 nRet = (fwrite(&Header, sizeof(Header), 1, fp) != 1);
+
+	for (INT32 i = 0; i < NEO_CACHE_REGIONS && nRet == 0; i++) {
+		if (Header.nLen[i] == 0) {
+			continue;
+		}
+
+		// Pad up to the region's aligned offset
+		for (long nPos = ftell(fp); nPos < (long)Header.nOffset[i] && nRet == 0; ) {
+			UINT32 nPad = Header.nOffset[i] - nPos;
+			if (nPad > sizeof(Padding)) {
+				nPad = sizeof(Padding);
+			}
+			nRet = (fwrite(Padding, 1, nPad, fp) != nPad);
+			nPos += nPad;
+		}
+
+		if (nRet == 0) {
+			nRet = (fwrite(pRegion[i], 1, Header.nLen[i], fp) != Header.nLen[i]);
+		}
+	}
+
+	if (fclose(fp)) {
+		nRet = 1;
+	}
+
+	if (nRet == 0) {
+		remove(szCacheName[nSlot]);
+		nRet = (rename(szTempName, szCacheName[nSlot]) != 0);
+	}
+
+	if (nRet) {
+		remove(szTempName);
+		return 1;
+	}
+
+	return 0;
+}
+
+// True if pData is the start of a region mapped from the cache file
+bool NeoROMCacheMapped(const UINT8* pData)
+{
+#if defined NEO_ROM_CACHE_MMAP
+	for (INT32 i = 0; i < nCacheMappings; i++) {
+		if (CacheMapping[i].pData == pData) {
+			return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
+// Ask the OS to start reading part of a mapped region in the background
+void NeoROMCachePrefetch(const UINT8* pData, UINT32 nLen)
+{
+#if defined NEO_ROM_CACHE_MMAP
+	static size_t nPageMask = 0;
+
+	if (nPageMask == 0) {
+		nPageMask = sysconf(_SC_PAGESIZE) - 1;
+	}
+
+	size_t nStart = (size_t)pData & ~nPageMask;
+	posix_madvise((void*)nStart, ((size_t)pData + nLen) - nStart, POSIX_MADV_WILLNEED);
+#else
+	(void)pData;
+	(void)nLen;
+#endif
+}
+
+void NeoROMCacheExit()
+{
+#if defined NEO_ROM_CACHE_MMAP
+	for (INT32 i = 0; i < nCacheMappings; i++) {
+		munmap(CacheMapping[i].pData, CacheMapping[i].nLen);
+	}
+	nCacheMappings = 0;
+#endif
+
+	for (INT32 i = 0; i < MAX_SLOT; i++) {
+		bCacheValid[i] = false;
+	}
+}
+
+#endif
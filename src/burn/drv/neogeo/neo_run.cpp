@@ -134,6 +134,9 @@ static UINT8 OldDebugDip[2];
 // Which 68K BIOS to use
 INT32 nBIOS;
 
+// Set once a frame ends with the cartridge in control, i.e. the BIOS has finished starting up
+bool bNeoBooted = false;
+
 // Joyports are multiplexed
 static INT32 nJoyport0[8] = { 0, };
 static INT32 nJoyport1[8] = { 0, };
@@ -600,6 +603,188 @@ static INT32 ReadSoundCache(UINT8* Audio)
 }
 #endif
 
+#if defined NEO_ROM_CACHE
+static UINT32 SpriteROMAllocSize()
+{
+	return nSpriteSize[nNeoActiveSlot] < (nNeoTileMask[nNeoActiveSlot] << 7) ? ((nNeoTileMask[nNeoActiveSlot] + 1) << 7) : nSpriteSize[nNeoActiveSlot];
+}
+
+// Warm start: take every region LoadRoms() would produce straight from the ROM cache
+static INT32 LoadRomsFromCache(NeoGameInfo* pInfo)
+{
+	if (NeoROMCacheOpen(nNeoActiveSlot)) {
+		return 1;
+	}
+
+	NeoSpriteROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_SPRITES, SpriteROMAllocSize());
+	NeoTextROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_TEXT, nNeoTextROMSize[nNeoActiveSlot]);
+	Neo68KROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_68K, nCodeSize[nNeoActiveSlot]);
+	NeoZ80ROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_Z80, 0x080000);
+
+	if (pInfo->nADPCMANum) {
+		YM2610ADPCMAROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_ADPCMA, nYM2610ADPCMASize[nNeoActiveSlot]);
+	}
+	if (pInfo->nADPCMBNum) {
+		YM2610ADPCMBROM[nNeoActiveSlot] = NeoROMCacheLoad(nNeoActiveSlot, NEO_CACHE_ADPCMB, nYM2610ADPCMBSize[nNeoActiveSlot]);
+	}
+
+	if (NeoSpriteROM[nNeoActiveSlot] == NULL || NeoTextROM[nNeoActiveSlot] == NULL || Neo68KROM[nNeoActiveSlot] == NULL || NeoZ80ROM[nNeoActiveSlot] == NULL ||
+		(pInfo->nADPCMANum && YM2610ADPCMAROM[nNeoActiveSlot] == NULL) || (pInfo->nADPCMBNum && YM2610ADPCMBROM[nNeoActiveSlot] == NULL)) {
+
+		// Incomplete, load the ROMs normally (mapped regions are released in NeoExit())
+		BurnFree(NeoSpriteROM[nNeoActiveSlot]);
+		BurnFree(NeoTextROM[nNeoActiveSlot]);
+		BurnFree(Neo68KROM[nNeoActiveSlot]);
+		BurnFree(NeoZ80ROM[nNeoActiveSlot]);
+		BurnFree(YM2610ADPCMAROM[nNeoActiveSlot]);
+		BurnFree(YM2610ADPCMBROM[nNeoActiveSlot]);
+		return 1;
+	}
+
+	Neo68KROMActive = Neo68KROM[nNeoActiveSlot];
+	Neo68KFix[nNeoActiveSlot] = Neo68KROM[nNeoActiveSlot];
+	NeoZ80ROMActive = NeoZ80ROM[nNeoActiveSlot];
+
+	if (pInfo->nADPCMBNum == 0) {
+		YM2610ADPCMBROM[nNeoActiveSlot] = YM2610ADPCMAROM[nNeoActiveSlot];
+		nYM2610ADPCMBSize[nNeoActiveSlot] = nYM2610ADPCMASize[nNeoActiveSlot];
+	}
+
+	return 0;
+}
+
+// Replace a region with its mapped copy in the cache, if it can be mapped
+static void SwapForCachedRegion(UINT8** ppRegion, INT32 nRegion, UINT32 nLen)
+{
+	UINT8* pCached = NeoROMCacheLoad(nNeoActiveSlot, nRegion, nLen);
+
+	if (pCached && NeoROMCacheMapped(pCached)) {
+		BurnFree(*ppRegion);
+		*ppRegion = pCached;
+	} else {
+		BurnFree(pCached);
+	}
+}
+
+// Cold start: store the regions exactly as LoadRoms() leaves them, before any driver post-processing
+static void SaveRomsToCache(NeoGameInfo* pInfo)
+{
+	UINT8* pRegion[NEO_CACHE_REGIONS];
+	UINT32 nRegionLen[NEO_CACHE_REGIONS];
+	UINT8* pTileAttrib;
+
+	if (!NeoROMCacheEnabled()) {
+		return;
+	}
+
+	pTileAttrib = (UINT8*)BurnMalloc(nNeoTileMask[nNeoActiveSlot] + 1);
+	if (pTileAttrib == NULL) {
+		return;
+	}
+	NeoBuildTileAttrib(pTileAttrib, NeoSpriteROM[nNeoActiveSlot], nNeoMaxTile[nNeoActiveSlot], nNeoTileMask[nNeoActiveSlot] + 1);
+
+	memset(pRegion, 0, sizeof(pRegion));
+	memset(nRegionLen, 0, sizeof(nRegionLen));
+
+	pRegion[NEO_CACHE_68K]        = Neo68KROM[nNeoActiveSlot];       nRegionLen[NEO_CACHE_68K]        = nCodeSize[nNeoActiveSlot];
+	pRegion[NEO_CACHE_Z80]        = NeoZ80ROM[nNeoActiveSlot];       nRegionLen[NEO_CACHE_Z80]        = 0x080000;
+	pRegion[NEO_CACHE_SPRITES]    = NeoSpriteROM[nNeoActiveSlot];    nRegionLen[NEO_CACHE_SPRITES]    = SpriteROMAllocSize();
+	pRegion[NEO_CACHE_TEXT]       = NeoTextROM[nNeoActiveSlot];      nRegionLen[NEO_CACHE_TEXT]       = nNeoTextROMSize[nNeoActiveSlot];
+	pRegion[NEO_CACHE_TILEATTRIB] = pTileAttrib;                     nRegionLen[NEO_CACHE_TILEATTRIB] = nNeoTileMask[nNeoActiveSlot] + 1;
+
+	if (pInfo->nADPCMANum) {
+		pRegion[NEO_CACHE_ADPCMA] = YM2610ADPCMAROM[nNeoActiveSlot]; nRegionLen[NEO_CACHE_ADPCMA]     = nYM2610ADPCMASize[nNeoActiveSlot];
+	}
+	if (pInfo->nADPCMBNum) {
+		pRegion[NEO_CACHE_ADPCMB] = YM2610ADPCMBROM[nNeoActiveSlot]; nRegionLen[NEO_CACHE_ADPCMB]     = nYM2610ADPCMBSize[nNeoActiveSlot];
+	}
+
+	INT32 nRet = NeoROMCacheSave(nNeoActiveSlot, pRegion, nRegionLen);
+
+	BurnFree(pTileAttrib);
+
+	if (nRet == 0 && NeoROMCacheOpen(nNeoActiveSlot) == 0) {
+		// Swap the decoded sprites for the copy just written, so they can be paged out just like after a warm start
+		SwapForCachedRegion(&NeoSpriteROM[nNeoActiveSlot], NEO_CACHE_SPRITES, SpriteROMAllocSize());
+
+		// A shared cache is only worth it if this instance doesn't keep copies of its own either
+		if (bNeoROMCacheShared) {
+			bool bADPCMAlias = (YM2610ADPCMBROM[nNeoActiveSlot] == YM2610ADPCMAROM[nNeoActiveSlot]);
+
+			SwapForCachedRegion(&NeoTextROM[nNeoActiveSlot], NEO_CACHE_TEXT, nNeoTextROMSize[nNeoActiveSlot]);
+			if (pInfo->nADPCMANum) {
+				SwapForCachedRegion(&YM2610ADPCMAROM[nNeoActiveSlot], NEO_CACHE_ADPCMA, nYM2610ADPCMASize[nNeoActiveSlot]);
+			}
+			if (bADPCMAlias) {
+				YM2610ADPCMBROM[nNeoActiveSlot] = YM2610ADPCMAROM[nNeoActiveSlot];
+			} else if (pInfo->nADPCMBNum) {
+				SwapForCachedRegion(&YM2610ADPCMBROM[nNeoActiveSlot], NEO_CACHE_ADPCMB, nYM2610ADPCMBSize[nNeoActiveSlot]);
+			}
+		}
+	}
+}
+
+// ADPCM-A samples mapped from the ROM cache are paged in as they play. Each key on passes the sample
+// on to NeoROMCachePrefetch() so the kernel reads it in the background; 64KB blocks hinted within the
+// last NEO_ADPCM_PREFETCH_AGE frames are skipped. The page cache takes care of eviction. Without the
+// ROM cache the V-ROM is loaded into memory whole and there is nothing to prefetch
+#define NEO_ADPCM_PREFETCH_SHIFT	(16)
+#define NEO_ADPCM_PREFETCH_AGE		(120)
+
+static UINT32* NeoADPCMPrefetchStamp = NULL;
+static const UINT8* NeoADPCMPrefetchROM = NULL;
+static UINT32 nNeoADPCMPrefetchBlocks = 0;
+
+static void NeoADPCMPrefetch(const UINT8* pData, UINT32 nLen)
+{
+	UINT32 nFrame = nCurrentFrame + 1;				// A stamp of 0 means never hinted
+	UINT32 nBlock = (pData - NeoADPCMPrefetchROM) >> NEO_ADPCM_PREFETCH_SHIFT;
+	UINT32 nLast = ((pData - NeoADPCMPrefetchROM) + nLen - 1) >> NEO_ADPCM_PREFETCH_SHIFT;
+
+	if (nLen == 0 || nLast >= nNeoADPCMPrefetchBlocks) {
+		return;
+	}
+
+	for (; nBlock <= nLast; nBlock++) {
+		if (NeoADPCMPrefetchStamp[nBlock] && nFrame - NeoADPCMPrefetchStamp[nBlock] < NEO_ADPCM_PREFETCH_AGE) {
+			continue;
+		}
+
+		NeoADPCMPrefetchStamp[nBlock] = nFrame;
+		NeoROMCachePrefetch(NeoADPCMPrefetchROM + (nBlock << NEO_ADPCM_PREFETCH_SHIFT), 1 << NEO_ADPCM_PREFETCH_SHIFT);
+	}
+}
+
+static void NeoADPCMPrefetchExit()
+{
+	YM2610ADPCMAPrefetch = NULL;
+
+	BurnFree(NeoADPCMPrefetchStamp);
+	NeoADPCMPrefetchROM = NULL;
+	nNeoADPCMPrefetchBlocks = 0;
+}
+
+// Hook up the prefetch if the active slot's ADPCM-A ROM is mapped from the cache
+static void NeoADPCMPrefetchInit()
+{
+	NeoADPCMPrefetchExit();
+
+	if ((nNeoSystemType & NEO_SYS_CART) == 0 || !NeoROMCacheMapped(YM2610ADPCMAROM[nNeoActiveSlot])) {
+		return;
+	}
+
+	nNeoADPCMPrefetchBlocks = ((UINT32)nYM2610ADPCMASize[nNeoActiveSlot] + (1 << NEO_ADPCM_PREFETCH_SHIFT) - 1) >> NEO_ADPCM_PREFETCH_SHIFT;
+	NeoADPCMPrefetchStamp = (UINT32*)BurnMalloc(nNeoADPCMPrefetchBlocks * sizeof(UINT32));
+	if (NeoADPCMPrefetchStamp == NULL) {
+		nNeoADPCMPrefetchBlocks = 0;
+		return;
+	}
+
+	NeoADPCMPrefetchROM = YM2610ADPCMAROM[nNeoActiveSlot];
+	YM2610ADPCMAPrefetch = NeoADPCMPrefetch;
+}
+#endif
+
 static INT32 LoadRoms(void)
 {
    NeoGameInfo info;
@@ -730,6 +915,11 @@ static INT32 LoadRoms(void)
    //	if (nSpriteSize[nNeoActiveSlot] > 0x4000000) {
    //		nSpriteSize[nNeoActiveSlot] = 0x5000000;
    //	}
+#if defined NEO_ROM_CACHE
+   if (LoadRomsFromCache(pInfo) == 0) {
+      return 0;
+   }
+#endif
 #ifdef WII_VM
    InitCache();
    if(!BurnUseCache)
@@ -778,40 +968,56 @@ static INT32 LoadRoms(void)
       }
    }
 
-   Neo68KROM[nNeoActiveSlot] = (UINT8*)BurnMalloc(nCodeSize[nNeoActiveSlot]);	// 68K cartridge ROM
+   // Stored (uncompressed) P and M1 ROMs are mapped from the archive, see NeoMapCode()
+   Neo68KROM[nNeoActiveSlot] = NeoMapCode(pInfo->nCodeOffset, pInfo->nCodeNum, nCodeSize[nNeoActiveSlot]);
    if (Neo68KROM[nNeoActiveSlot] == NULL)
    {
+      Neo68KROM[nNeoActiveSlot] = (UINT8*)BurnMalloc(nCodeSize[nNeoActiveSlot]);	// 68K cartridge ROM
+      if (Neo68KROM[nNeoActiveSlot] == NULL)
+      {
 #ifdef WII_VM
-      printf("Loading Neo68KROM failed. Not enough memory! exiting...\r");
-      sleep(5);
-      exit(0);
+         printf("Loading Neo68KROM failed. Not enough memory! exiting...\r");
+         sleep(5);
+         exit(0);
 #endif
-      return 1;
+         return 1;
+      }
+
+      // Load the roms into memory
+      if (BurnDrvGetHardwareCode() & HARDWARE_SNK_SMA_PROTECTION) {
+         BurnLoadRom(Neo68KROM[nNeoActiveSlot] + 0x0C0000, 0, 1);
+         NeoLoadCode(pInfo->nCodeOffset + 1, pInfo->nCodeNum - 1, Neo68KROM[nNeoActiveSlot] + 0x100000);
+      } else {
+         NeoLoadCode(pInfo->nCodeOffset, pInfo->nCodeNum, Neo68KROM[nNeoActiveSlot]);
+      }
    }
    Neo68KROMActive = Neo68KROM[nNeoActiveSlot];
    Neo68KFix[nNeoActiveSlot] = Neo68KROM[nNeoActiveSlot];
 
-   // Load the roms into memory
-   if (BurnDrvGetHardwareCode() & HARDWARE_SNK_SMA_PROTECTION) {
-      BurnLoadRom(Neo68KROMActive + 0x0C0000, 0, 1);
-      NeoLoadCode(pInfo->nCodeOffset + 1, pInfo->nCodeNum - 1, Neo68KROMActive + 0x100000);
-   } else {
-      NeoLoadCode(pInfo->nCodeOffset, pInfo->nCodeNum, Neo68KROMActive);
-   }
+   {
+      struct BurnRomInfo ri;
 
-   NeoZ80ROM[nNeoActiveSlot] = (UINT8*)BurnMalloc(0x080000);	// Z80 cartridge ROM
+      ri.nLen = 0;
+      BurnDrvGetRomInfo(&ri, pInfo->nSoundOffset);
+      NeoZ80ROM[nNeoActiveSlot] = (ri.nLen == 0x080000) ? BurnMapRom(pInfo->nSoundOffset) : NULL;
+   }
    if (NeoZ80ROM[nNeoActiveSlot] == NULL)
    {
+      NeoZ80ROM[nNeoActiveSlot] = (UINT8*)BurnMalloc(0x080000);	// Z80 cartridge ROM
+      if (NeoZ80ROM[nNeoActiveSlot] == NULL)
+      {
 #ifdef WII_VM
-      printf("Loading NeoZ80ROM failed. Not enough memory! exiting...\r");
-      sleep(5);
-      exit(0);
+         printf("Loading NeoZ80ROM failed. Not enough memory! exiting...\r");
+         sleep(5);
+         exit(0);
 #endif
-      return 1;
+         return 1;
+      }
+
+      BurnLoadRom(NeoZ80ROM[nNeoActiveSlot], pInfo->nSoundOffset, 1);
    }
    NeoZ80ROMActive = NeoZ80ROM[nNeoActiveSlot]; 
 
-   BurnLoadRom(NeoZ80ROMActive, pInfo->nSoundOffset, 1);
    if (BurnDrvGetHardwareCode() & HARDWARE_SNK_ENCRYPTED_M1) {
       neogeo_cmc50_m1_decrypt();
    }
@@ -904,6 +1110,9 @@ static INT32 LoadRoms(void)
       YM2610ADPCMBROM[nNeoActiveSlot] = YM2610ADPCMAROM[nNeoActiveSlot];
       nYM2610ADPCMBSize[nNeoActiveSlot] = nYM2610ADPCMASize[nNeoActiveSlot];
    }
+#if defined NEO_ROM_CACHE
+   SaveRomsToCache(pInfo);
+#endif
    return 0;
 }
 
@@ -1287,6 +1496,9 @@ static void NeoMapActiveCartridge(void)
 	memset(NeoGraphicsRAM + 0xEA00, 0, 0x0200);
 
 	BurnYM2610MapADPCMROM(YM2610ADPCMAROM[nNeoActiveSlot], nYM2610ADPCMASize[nNeoActiveSlot], YM2610ADPCMBROM[nNeoActiveSlot], nYM2610ADPCMBSize[nNeoActiveSlot]);
+#if defined NEO_ROM_CACHE
+	NeoADPCMPrefetchInit();
+#endif
 
 	return;
 }
@@ -1300,7 +1512,7 @@ INT32 NeoScan(INT32 nAction, INT32* pnMin)
 	struct BurnArea ba;
 
 	if (pnMin) // Return minimum compatible version
-		*pnMin =  0x029713;
+		*pnMin = (nAction & ACB_DRIVER_DATA) ? 0x029732 : 0x029713;
 
 	// Make sure we have the correct value for nBIOS
 	if (nAction & ACB_DRIVER_DATA)
@@ -1553,6 +1765,9 @@ INT32 NeoScan(INT32 nAction, INT32* pnMin)
 
 		SCAN_OFF(Neo68KFix[nNeoActiveSlot], Neo68KROM[nNeoActiveSlot], nAction);
 
+		SCAN_VAR(nLEDLatch);
+		SCAN_VAR(nLED);
+
 		if (nAction & ACB_WRITE) {
 			INT32 nNewBIOS = nBIOS;
 			INT32 nBank;
@@ -1601,9 +1816,6 @@ INT32 NeoScan(INT32 nAction, INT32* pnMin)
 			}
 
 			nPrevBurnCPUSpeedAdjust = -1;
-
-			SCAN_VAR(nLEDLatch);
-			SCAN_VAR(nLED[3]);
 		}
 	}
 
@@ -2178,20 +2390,26 @@ void __fastcall neogeoWriteByteVideo(UINT32 sekAddress, UINT8 byteValue)
 // ----------------------------------------------------------------------------
 // Backup RAM on MVS hardware
 
+// Writes that change the contents are counted in nBurnNVRAMChanges, so the frontend knows when to save
+
 void __fastcall neogeoWriteByteSRAM(UINT32 sekAddress, UINT8 byteValue)
 {
 	sekAddress &= 0xFFFF;
 
-	if (bSRAMWritable)
+	if (bSRAMWritable && NeoNVRAM[sekAddress ^ 1] != byteValue) {
 		NeoNVRAM[sekAddress ^ 1] = byteValue;
+		nBurnNVRAMChanges++;
+	}
 }
 
 void __fastcall neogeoWriteWordSRAM(UINT32 sekAddress, UINT16 wordValue)
 {
 	sekAddress &= 0xFFFF;
 
-	if (bSRAMWritable)
+	if (bSRAMWritable && *((UINT16*)(NeoNVRAM + sekAddress)) != BURN_ENDIAN_SWAP_INT16(wordValue)) {
 		*((UINT16*)(NeoNVRAM + sekAddress)) = BURN_ENDIAN_SWAP_INT16(wordValue);
+		nBurnNVRAMChanges++;
+	}
 }
 
 // ----------------------------------------------------------------------------
@@ -2211,8 +2429,10 @@ void __fastcall neogeoWriteByteMemoryCard(UINT32 sekAddress, UINT8 byteValue)
 {
 	if (bMemoryCardInserted && bMemoryCardWritable)
    {
-		if ((NeoSystem & 0x40) || (sekAddress & 1))
+		if (((NeoSystem & 0x40) || (sekAddress & 1)) && NeoMemoryCard[sekAddress & 0x01FFFF] != byteValue) {
 			NeoMemoryCard[sekAddress & 0x01FFFF] = byteValue;
+			nBurnNVRAMChanges++;
+		}
 	}
 }
 
@@ -2228,8 +2448,10 @@ UINT8 __fastcall neoCDReadByteMemoryCard(UINT32 sekAddress)
 void __fastcall neoCDWriteByteMemoryCard(UINT32 sekAddress, UINT8 byteValue)
 {
 	sekAddress &= 0x01FFFF;
-	if (sekAddress < 0x4000 && sekAddress & 1)
+	if (sekAddress < 0x4000 && sekAddress & 1 && NeoMemoryCard[sekAddress] != byteValue) {
 		NeoMemoryCard[sekAddress] = byteValue;
+		nBurnNVRAMChanges++;
+	}
 }
 
 // ----------------------------------------------------------------------------
@@ -3259,6 +3481,8 @@ static INT32 neogeoReset(void)
 	bZ80BoardROMBankedIn = false;
 	b68KBoardROMBankedIn = true;
 
+	bNeoBooted = false;
+
 	nNeoPaletteBank = -1;
 
 	nSpriteFrameSpeed = 4;
@@ -3282,6 +3506,9 @@ static INT32 neogeoReset(void)
 	nInputSelect = 0;
 	NeoInputBank = NeoInput;
 
+	NeoGraphicsRAMBank = NeoGraphicsRAM;
+	NeoGraphicsRAMPointer = 0;
+
 	nCyclesExtra[0] = nCyclesExtra[1] = 0;
 
 	{
@@ -3866,6 +4093,9 @@ INT32 NeoExit()
 	NeoExitPalette();
 
 	BurnYM2610Exit();
+#if defined NEO_ROM_CACHE
+	NeoADPCMPrefetchExit();
+#endif
 
 	ZetExit();									// Deallocate Z80
 	SekExit();									// Deallocate 68000
@@ -3903,6 +4133,9 @@ INT32 NeoExit()
 		NeoExitSprites(0);
 		NeoExitText(0);
 	}
+#endif
+#if defined NEO_ROM_CACHE
+	NeoROMCacheExit();								// Unmap cached ROM regions
 #endif
 	BurnFree(AllROM);								// Misc ROM
 	BurnFree(AllRAM);								// Misc RAM
@@ -4180,7 +4413,7 @@ INT32 NeoFrame(void)
 	bRenderImage = false;
 	bForceUpdateOnStatusRead = false;
 
-	if (nSkipFrame) {
+	if (nSkipFrame || bBurnNoRender) {
 		pBurnDraw = NULL;
 	}
 
@@ -4398,6 +4631,11 @@ INT32 NeoFrame(void)
 	nCyclesExtra[0] = SekTotalCycles() - nCyclesTotal[0];
 	nCyclesExtra[1] = ZetTotalCycles() - nCyclesTotal[1];
 
+	// The BIOS hands over to the cartridge by selecting its vector table and jumping into it
+	if ((nNeoSystemType & NEO_SYS_CART) && !b68KBoardROMBankedIn && (UINT32)SekGetPC(-1) < 0xC00000) {
+		bNeoBooted = true;
+	}
+
 	ZetClose();
 	SekClose();
 
@@ -39,6 +39,62 @@ static RenderBankFunction* RenderBank;
 
 static 	UINT16 BankAttrib01, BankAttrib02, BankAttrib03;
 
+#if defined NEO_ROM_CACHE
+// When the sprite ROM is mapped from the ROM cache, pages that aren't resident are read in as the
+// renderer faults on them, one at a time. Instead, the tiles used by the sprite list are collected
+// once per frame before drawing and the 64KB blocks holding them are passed to the OS as read-ahead
+// hints, so they load together. Each block is hinted again at most every NEO_PREFETCH_AGE frames
+#define NEO_PREFETCH_SHIFT		(9)			// 512 tiles, 64KB
+#define NEO_PREFETCH_QUEUE		(64)
+#define NEO_PREFETCH_AGE		(120)
+
+static UINT32* NeoPrefetchStamp[MAX_SLOT] = { NULL, };
+static UINT32* NeoPrefetchStampActive;
+static UINT32 nNeoPrefetchFrame;
+
+static void NeoPrefetchSprites()
+{
+	UINT32 nQueue[NEO_PREFETCH_QUEUE];
+	INT32 nQueued = 0;
+	INT32 nSize = 0;
+	UINT32 nFrame = nCurrentFrame + 1;				// A stamp of 0 means never hinted
+
+	if (nNeoPrefetchFrame == nFrame) {
+		return;
+	}
+	nNeoPrefetchFrame = nFrame;
+
+	for (INT32 nBank = 0; nBank < 0x17D && nQueued < NEO_PREFETCH_QUEUE; nBank++) {
+		UINT16 nAttrib02 = *((UINT16*)(NeoGraphicsRAM + 0x010400 + (nBank << 1)));
+		UINT16* pTiles = (UINT16*)(NeoGraphicsRAM + (nBank << 7));
+
+		// Chained banks keep the size of the bank they're stuck to
+		if ((nAttrib02 & 0x40) == 0) {
+			nSize = nAttrib02 & 0x3F;
+		}
+
+		for (INT32 i = 0; i < nSize && i < 0x20 && nQueued < NEO_PREFETCH_QUEUE; i++) {
+			UINT32 nTile = (pTiles[i << 1] + ((pTiles[(i << 1) + 1] & 0xF0) << 12)) & nNeoTileMaskActive;
+			UINT32 nBlock = nTile >> NEO_PREFETCH_SHIFT;
+
+			if (NeoTileAttribActive[nTile]) {
+				continue;
+			}
+			if (NeoPrefetchStampActive[nBlock] && nFrame - NeoPrefetchStampActive[nBlock] < NEO_PREFETCH_AGE) {
+				continue;
+			}
+
+			NeoPrefetchStampActive[nBlock] = nFrame;
+			nQueue[nQueued++] = nBlock;
+		}
+	}
+
+	for (INT32 i = 0; i < nQueued; i++) {
+		NeoROMCachePrefetch(NeoSpriteROMActive + (nQueue[i] << (NEO_PREFETCH_SHIFT + 7)), 1 << (NEO_PREFETCH_SHIFT + 7));
+	}
+}
+#endif
+
 
 // Include the tile rendering functions
 #include "neo_sprite_func.h"
@@ -57,6 +113,12 @@ INT32 NeoRenderSprites(void)
 
 	nNeoSpriteFrame04 = nNeoSpriteFrame & 3;
 	nNeoSpriteFrame08 = nNeoSpriteFrame & 7;
+
+#if defined NEO_ROM_CACHE
+	if (NeoPrefetchStampActive) {
+		NeoPrefetchSprites();
+	}
+#endif
 	
 	// ssrpg hack! - NeoCD/SDL
 	INT32 nStart = 0;
@@ -137,10 +199,51 @@ void NeoSetSpriteSlot(INT32 nSlot)
 	NeoSpriteROMActive  = NeoSpriteROM[nSlot];
 	nNeoTileMaskActive  = nNeoTileMask[nSlot];
 	nNeoMaxTileActive   = nNeoMaxTile[nSlot];
+#if defined NEO_ROM_CACHE
+	NeoPrefetchStampActive = NeoPrefetchStamp[nSlot];
+#endif
+}
+
+// Create a table that indicates if a tile is transparent
+void NeoBuildTileAttrib(UINT8* pDest, UINT8* pSprites, INT32 nMaxTile, UINT32 nSize)
+{
+	for (INT32 i = 0; i < nMaxTile; i++) {
+		bool bTransparent = true;
+		for (INT32 j = i << 7; j < (i + 1) << 7; j++) {
+			if (pSprites[j]) {
+				bTransparent = false;
+				break;
+			}
+		}
+		if (bTransparent) {
+			pDest[i] = 1;
+		} else {
+			pDest[i] = 0;
+		}
+	}
+
+	for (UINT32 i = nMaxTile; i < nSize; i++) {
+		pDest[i] = 1;
+	}
 }
 
 INT32 NeoInitSprites(INT32 nSlot)
 {
+#if defined NEO_ROM_CACHE
+	// A warm start gets the table along with the decoded sprites
+	NeoTileAttrib[nSlot] = NeoROMCacheLoad(nSlot, NEO_CACHE_TILEATTRIB, nNeoTileMask[nSlot] + 1);
+	if (NeoTileAttrib[nSlot] == NULL) {
+		NeoTileAttrib[nSlot] = (UINT8*)BurnMalloc(nNeoTileMask[nSlot] + 1);
+		NeoBuildTileAttrib(NeoTileAttrib[nSlot], NeoSpriteROM[nSlot], nNeoMaxTile[nSlot], nNeoTileMask[nSlot] + 1);
+	}
+
+	NeoPrefetchStamp[nSlot] = NULL;
+	if (NeoROMCacheMapped(NeoSpriteROM[nSlot])) {
+		NeoPrefetchStamp[nSlot] = (UINT32*)BurnMalloc((((nNeoTileMask[nSlot] + 1) >> NEO_PREFETCH_SHIFT) + 1) * sizeof(UINT32));
+	}
+	NeoPrefetchStampActive = NeoPrefetchStamp[nSlot];
+	nNeoPrefetchFrame = 0;
+#else
 	// Create a table that indicates if a tile is transparent
 	NeoTileAttrib[nSlot] = (UINT8*)BurnMalloc(nNeoTileMask[nSlot] + 1);
 #ifdef WII_VM
@@ -154,46 +257,14 @@ INT32 NeoInitSprites(INT32 nSlot)
 		BurnCacheFile = fopen(CacheFile, "rb");
 		fread( NeoTileAttrib[nSlot], nNeoTileMask[nSlot] + 1, 1, BurnCacheFile);
 		fclose(BurnCacheFile);
+
+		for (UINT32 i = nNeoMaxTile[nSlot]; i < nNeoTileMask[nSlot] + 1; i++)
+			NeoTileAttrib[nSlot][i] = 1;
 	}
 	else
-	{
-		for (INT32 i = 0; i < nNeoMaxTile[nSlot]; i++)
-		 {
-			bool bTransparent = true;
-			for (INT32 j = i << 7; j < (i + 1) << 7; j++)
-		    {
-				if (NeoSpriteROM[nSlot][j])
-		       {
-					bTransparent = false;
-					break;
-				}
-			}
-			if (bTransparent)
-				NeoTileAttrib[nSlot][i] = 1;
-		    else
-				NeoTileAttrib[nSlot][i] = 0;
-		}
-	}
-#else
-		for (INT32 i = 0; i < nNeoMaxTile[nSlot]; i++)
-		 {
-			bool bTransparent = true;
-			for (INT32 j = i << 7; j < (i + 1) << 7; j++)
-		    {
-				if (NeoSpriteROM[nSlot][j])
-		       {
-					bTransparent = false;
-					break;
-				}
-			}
-			if (bTransparent)
-				NeoTileAttrib[nSlot][i] = 1;
-		    else
-				NeoTileAttrib[nSlot][i] = 0;
-		}
 #endif
-	for (UINT32 i = nNeoMaxTile[nSlot]; i < nNeoTileMask[nSlot] + 1; i++)
-		NeoTileAttrib[nSlot][i] = 1;
+		NeoBuildTileAttrib(NeoTileAttrib[nSlot], NeoSpriteROM[nSlot], nNeoMaxTile[nSlot], nNeoTileMask[nSlot] + 1);
+#endif
 
 	NeoTileAttribActive = NeoTileAttrib[nSlot];
 	NeoSpriteROMActive  = NeoSpriteROM[nSlot];
@@ -207,4 +278,8 @@ void NeoExitSprites(INT32 nSlot)
 {
 	BurnFree(NeoTileAttrib[nSlot]);
 	NeoTileAttribActive = NULL;
+#if defined NEO_ROM_CACHE
+	BurnFree(NeoPrefetchStamp[nSlot]);
+	NeoPrefetchStampActive = NULL;
+#endif
 }
@@ -23,6 +23,30 @@ static struct {
 
 static UINT32 nOneSecond;
 
+// Set the time of the uPD4990A to the current local time, or to nBurnClockTime if that is set. A set
+// time is taken as UTC, so runs started from it are the same whatever the host's time zone
+void uPD4990ASetTime()
+{
+	time_t nLocalTime;
+	tm* tmLocalTime;
+
+	if (nBurnClockTime) {
+		nLocalTime = (time_t)nBurnClockTime;
+		tmLocalTime = gmtime(&nLocalTime);
+	} else {
+		nLocalTime = time(NULL);
+		tmLocalTime = localtime(&nLocalTime);
+	}
+
+	uPD4990A.nSeconds = tmLocalTime->tm_sec;
+	uPD4990A.nMinutes = tmLocalTime->tm_min;
+	uPD4990A.nHours   = tmLocalTime->tm_hour;
+	uPD4990A.nDay     = tmLocalTime->tm_mday;
+	uPD4990A.nWeekDay = tmLocalTime->tm_wday;
+	uPD4990A.nMonth   = tmLocalTime->tm_mon + 1;
+	uPD4990A.nYear    = tmLocalTime->tm_year % 100;
+}
+
 INT32 uPD4990AInit(UINT32 nTicksPerSecond)
 {
 	nOneSecond = nTicksPerSecond;
@@ -39,17 +63,7 @@ INT32 uPD4990AInit(UINT32 nTicksPerSecond)
 
 	uPD4990A.TP = 0;
 
-	// Set the time of the uPD4990A to the current local time
-	time_t nLocalTime = time(NULL);
-	tm* tmLocalTime = localtime(&nLocalTime);
-
-	uPD4990A.nSeconds = tmLocalTime->tm_sec;
-	uPD4990A.nMinutes = tmLocalTime->tm_min;
-	uPD4990A.nHours   = tmLocalTime->tm_hour;
-	uPD4990A.nDay     = tmLocalTime->tm_mday;
-	uPD4990A.nWeekDay = tmLocalTime->tm_wday;
-	uPD4990A.nMonth   = tmLocalTime->tm_mon + 1;
-	uPD4990A.nYear    = tmLocalTime->tm_year % 100;
+	uPD4990ASetTime();
 
 	return 0;
 }
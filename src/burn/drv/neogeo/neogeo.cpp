@@ -5,6 +5,15 @@
 
 UINT8 nNeoProtectionXor;
 
+static void NeoSwapCodeHalves(UINT8* pDest, UINT32 nLen)
+{
+	for (UINT32 j = 0; j < (nLen / 2); j++) {
+		INT32 k = pDest[j];
+		pDest[j] = pDest[j + (nLen / 2)];
+		pDest[j + (nLen / 2)] = k;
+	}
+}
+
 // This function loads the 68K ROMs
 INT32 NeoLoadCode(INT32 nOffset, INT32 nNum, UINT8* pDest)
 {
@@ -33,11 +42,7 @@ INT32 NeoLoadCode(INT32 nOffset, INT32 nNum, UINT8* pDest)
       }
 
       if ((BurnDrvGetHardwareCode() & HARDWARE_SNK_SWAPP) && (i == 0)) {
-         for (UINT32 j = 0; j < (ri.nLen / 2); j++) {
-            INT32 k = pDest[j];
-            pDest[j] = pDest[j + (ri.nLen / 2)];
-            pDest[j + (ri.nLen / 2)] = k;
-         }
+         NeoSwapCodeHalves(pDest, ri.nLen);
       }
 
       pDest += ri.nLen;
@@ -46,6 +51,32 @@ INT32 NeoLoadCode(INT32 nOffset, INT32 nNum, UINT8* pDest)
 	return 0;
 }
 
+// Map the 68K ROM straight from an uncompressed archive instead of loading it. Only done for games with a
+// single P ROM that fills the whole region; the SWAPP fixup (and any later decryption) then only touches
+// the process' private copy of the pages. Returns NULL if the ROM has to be loaded with NeoLoadCode()
+UINT8* NeoMapCode(INT32 nOffset, INT32 nNum, UINT32 nLen)
+{
+	struct BurnRomInfo ri;
+	UINT8* pDest;
+
+	if (nNum != 1 || (BurnDrvGetHardwareCode() & (HARDWARE_SNK_P32 | HARDWARE_SNK_SMA_PROTECTION))) {
+		return NULL;
+	}
+
+	ri.nLen = 0;
+	BurnDrvGetRomInfo(&ri, nOffset);
+	if (ri.nLen != nLen) {
+		return NULL;
+	}
+
+	pDest = BurnMapRom(nOffset);
+	if (pDest && (BurnDrvGetHardwareCode() & HARDWARE_SNK_SWAPP)) {
+		NeoSwapCodeHalves(pDest, ri.nLen);
+	}
+
+	return pDest;
+}
+
 static void NeoSVCAddressDecrypt(UINT8* src, UINT8* dst, INT32 start, INT32 end)
 {
 	for (INT32 i = start / 4; i < end / 4; i++)
@@ -64,6 +95,30 @@ static void NeoPCBDataDecrypt(UINT8* dst, INT32 size)
 		((UINT32*)dst)[i] = BURN_ENDIAN_SWAP_INT32(BITSWAP32(0xE9C42134 ^ BURN_ENDIAN_SWAP_INT32(((UINT32*)dst)[i]), 0x09, 0x0D, 0x13, 0x00, 0x17, 0x0F, 0x03, 0x05, 0x04, 0x0C, 0x11, 0x1E, 0x12, 0x15, 0x0B, 0x06, 0x1B, 0x0A, 0x1A, 0x1C, 0x14, 0x02, 0x0e, 0x1D, 0x18, 0x08, 0x01, 0x10, 0x19, 0x1F, 0x07, 0x16));
 }
 
+// One 4MB block of a C ROM pair per job. Blocks land at distinct addresses in the
+// decrypted sprite ROM, so they can be decrypted in any order and on any thread
+struct NeoCMCBlockJob {
+	UINT8* pDest;
+	UINT8* pBuf1;
+	UINT8* pBuf2;
+	INT32 nOffset;
+	INT32 nSpriteSize;
+	bool bPCB;
+	bool bKOF2K3;
+};
+
+static void NeoCMCDecryptBlock(INT32 nBlock, void* pParam)
+{
+	NeoCMCBlockJob* pJob = (NeoCMCBlockJob*)pParam;
+	INT32 j = nBlock * 0x400000;
+
+	if (pJob->bPCB) {
+		pJob->bKOF2K3 ? NeoKOFAddressDecrypt(pJob->pBuf2, pJob->pBuf1, j, j + 0x400000) : NeoSVCAddressDecrypt(pJob->pBuf2, pJob->pBuf1, j, j + 0x400000);
+		NeoPCBDataDecrypt(pJob->pBuf1 + j, 0x400000);
+	}
+	NeoCMCDecrypt(nNeoProtectionXor, pJob->pDest, pJob->pBuf1 + j, pJob->nOffset + j, 0x400000, pJob->nSpriteSize);
+}
+
 // This function loads and pre-processes the sprite data
 INT32 NeoLoadSprites(INT32 nOffset, INT32 nNum, UINT8* pDest, UINT32 nSpriteSize)
 {
@@ -128,28 +183,32 @@ INT32 NeoLoadSprites(INT32 nOffset, INT32 nNum, UINT8* pDest, UINT32 nSpriteSize
 
 			BurnUpdateProgress(1.0 / ((double)(nSpriteSize/0x800000) * 8.0 / (nRomSize / 0x400000) / 3.0), _T("Decrypting graphics..."), 0);
 
+			NeoCMCBlockJob Job;
+
+			Job.pBuf1   = pBuf1;
+			Job.pBuf2   = pBuf2;
+			Job.bPCB    = (BurnDrvGetHardwareCode() & HARDWARE_PUBLIC_MASK) == HARDWARE_SNK_DEDICATED_PCB;
+			Job.bKOF2K3 = (BurnDrvGetHardwareCode() & HARDWARE_SNK_KOF2K3) != 0;
+
 			if ((i * nRomSize * 2) < 0x04000000)
          {
-				for (UINT32 j = 0; j < nRomSize * 2; j += 0x400000)
-            {
-					if ((BurnDrvGetHardwareCode() & HARDWARE_PUBLIC_MASK) == HARDWARE_SNK_DEDICATED_PCB)
-               {
-						(BurnDrvGetHardwareCode() & HARDWARE_SNK_KOF2K3) ? NeoKOFAddressDecrypt(pBuf2, pBuf1, j, j + 0x400000) : NeoSVCAddressDecrypt(pBuf2, pBuf1, j, j + 0x400000);
-						NeoPCBDataDecrypt(pBuf1 + j, 0x400000);
-					}
-					NeoCMCDecrypt(nNeoProtectionXor, pDest, pBuf1 + j, i * (nRomSize * 2) + j, 0x400000, nSpriteSize);
-				}
+				Job.pDest       = pDest;
+				Job.nOffset     = i * (nRomSize * 2);
+				Job.nSpriteSize = nSpriteSize;
+
+				BurnThreadRun(NeoCMCDecryptBlock, &Job, (nRomSize * 2 + 0x3FFFFF) / 0x400000);
 			}
          else
          {
 				// The kof2k3 PCB has 96MB of graphics ROM, however the last 16MB are unused, and the protection/decryption hardware does not see them
 
-				for (UINT32 j = 0; j < nRomSize; j += 0x400000)
-            {
-					NeoKOFAddressDecrypt(pBuf2, pBuf1, j, j + 0x400000);
-					NeoPCBDataDecrypt(pBuf1 + j, 0x400000);
-					NeoCMCDecrypt(nNeoProtectionXor, pDest + 0x4000000, pBuf1 + j, j, 0x400000, 0x1000000);
-				}
+				Job.pDest       = pDest + 0x4000000;
+				Job.nOffset     = 0;
+				Job.nSpriteSize = 0x1000000;
+				Job.bPCB        = true;
+				Job.bKOF2K3     = true;
+
+				BurnThreadRun(NeoCMCDecryptBlock, &Job, (nRomSize + 0x3FFFFF) / 0x400000);
 			}
 		}
 
@@ -223,97 +282,155 @@ INT32 NeoLoadSprites(INT32 nOffset, INT32 nNum, UINT8* pDest, UINT32 nSpriteSize
 
 
 // ----------------------------------------------------------------------------
-// Graphics decoding for MVS/AES
-
-void NeoDecodeSprites(UINT8* pDest, INT32 nSize)
+// Sprite tile conversion
+//
+// A 16x16 tile is stored as 128 bytes of bitplanes: for each row, four bytes
+// holding bit 0..3 of the 8 right hand pixels (bytes 0-63) and then of the 8
+// left hand pixels (bytes 64-127). It is converted in place to two 32-bit
+// words of packed 4bpp per row, left half first, pixel x in bits 4x..4x+3.
+//
+// The plane bytes are turned into nibbles by spreading bit x of each byte to
+// bit 4x, which is a few shifts and masks per plane rather than a loop per
+// pixel. With SSE2, four rows are converted side by side.
+// MVS/AES carts store the middle planes in the order 0, 2, 1, 3, the CD in
+// the order 0, 1, 2, 3; nShift1 and nShift2 give the bit the planes in bytes
+// 1 and 2 end up in.
+
+#if defined __SSE2__
+ #include <emmintrin.h>
+
+static inline __m128i NeoSpreadBits(__m128i b)
 {
-	for (INT32 i = 0; i < 8; i++) {
+	b = _mm_and_si128(_mm_or_si128(b, _mm_slli_epi32(b, 12)), _mm_set1_epi32(0x000F000F));
+	b = _mm_and_si128(_mm_or_si128(b, _mm_slli_epi32(b,  6)), _mm_set1_epi32(0x03030303));
+	b = _mm_and_si128(_mm_or_si128(b, _mm_slli_epi32(b,  3)), _mm_set1_epi32(0x11111111));
 
-		UINT8* pStart = pDest + i * (nSize >> 3);
-		UINT8* pEnd = pStart + (nSize >> 3);
+	return b;
+}
 
-		INT32 nStep = 8;
-		if (BurnDrvGetHardwareCode() & (HARDWARE_SNK_CMC42 | HARDWARE_SNK_CMC50))
-			nStep *= 4;
-		BurnUpdateProgress(1.0 / nStep, i ? NULL : _T("Preprocessing graphics..."), 0);
+// Four rows of one half, one row per 32-bit lane
+static inline __m128i NeoDecodeRows(__m128i r, const INT32 nShift1, const INT32 nShift2)
+{
+	const __m128i nMask = _mm_set1_epi32(0xFF);
 
-		// Pre-process the sprite graphics
-		for (UINT8* pTile = pStart; pTile < pEnd; pTile += 128)
-      {
-         UINT32 data[32];
+	__m128i p0 = NeoSpreadBits(_mm_and_si128(r, nMask));
+	__m128i p1 = NeoSpreadBits(_mm_and_si128(_mm_srli_epi32(r,  8), nMask));
+	__m128i p2 = NeoSpreadBits(_mm_and_si128(_mm_srli_epi32(r, 16), nMask));
+	__m128i p3 = NeoSpreadBits(_mm_srli_epi32(r, 24));
 
-         for (INT32 y = 0; y < 16; y++)
-         {
-            UINT32 n = 0;
-            for (INT32 x = 0; x < 8; x++)
-            {
-               UINT32 m = ((pTile[67 + (y << 2)] >> x) & 1) << 3;
-               m |= ((pTile[65 + (y << 2)] >> x) & 1) << 2;
-               m |= ((pTile[66 + (y << 2)] >> x) & 1) << 1;
-               m |= ((pTile[64 + (y << 2)] >> x) & 1) << 0;
+	return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(p3, 3), _mm_slli_epi32(p1, nShift1)), _mm_or_si128(_mm_slli_epi32(p2, nShift2), p0));
+}
 
-               n |= m << (x << 2);
-            }
-            data[(y << 1) + 0] = n;
+static inline void NeoDecodeTile(const UINT8* pTile, UINT8* pDest, const INT32 nShift1, const INT32 nShift2)
+{
+	__m128i data[8];
 
-            n = 0;
-            for (INT32 x = 0; x < 8; x++)
-            {
-               UINT32 m = ((pTile[3 + (y << 2)] >> x) & 1) << 3;
-               m |= ((pTile[1 + (y << 2)] >> x) & 1) << 2;
-               m |= ((pTile[2 + (y << 2)] >> x) & 1) << 1;
-               m |= ((pTile[0 + (y << 2)] >> x) & 1) << 0;
+	for (INT32 i = 0; i < 4; i++) {
+		__m128i l = NeoDecodeRows(_mm_loadu_si128((const __m128i*)(pTile + 64 + (i << 4))), nShift1, nShift2);
+		__m128i r = NeoDecodeRows(_mm_loadu_si128((const __m128i*)(pTile +  0 + (i << 4))), nShift1, nShift2);
 
-               n |= m << (x << 2);
-            }
-            data[(y << 1) + 1] = n;
-         }
-         for (INT32 n = 0; n < 32; n++)
-            ((UINT32*)pTile)[n] = data[n];
-      }
+		data[(i << 1) + 0] = _mm_unpacklo_epi32(l, r);
+		data[(i << 1) + 1] = _mm_unpackhi_epi32(l, r);
+	}
+
+	for (INT32 i = 0; i < 8; i++) {
+		_mm_storeu_si128((__m128i*)(pDest + (i << 4)), data[i]);
 	}
 }
+#else
+static inline UINT32 NeoSpreadBits(UINT32 b)
+{
+	b = (b | (b << 12)) & 0x000F000F;
+	b = (b | (b <<  6)) & 0x03030303;
+	b = (b | (b <<  3)) & 0x11111111;
 
-// ----------------------------------------------------------------------------
-// Graphics decoding for Neo CD
-#ifdef WANT_NEOGEOCD
-void NeoDecodeSpritesCD(UINT8* pData, UINT8* pDest, INT32 nSize)
+	return b;
+}
+
+static inline void NeoDecodeTile(const UINT8* pTile, UINT8* pDest, const INT32 nShift1, const INT32 nShift2)
 {
-	UINT8* pEnd = pData + nSize;
+	UINT32 data[32];
 
-	for (UINT8* pTile = pData; pTile < pEnd; pTile += 128, pDest += 128) {
-		UINT32 data[32];
+	for (INT32 y = 0; y < 16; y++) {
+		const UINT8* pRow = pTile + (y << 2);
 
-		for (INT32 y = 0; y < 16; y++) {
-			UINT32 n = 0;
+		data[(y << 1) + 0] = (NeoSpreadBits(pRow[67]) << 3) | (NeoSpreadBits(pRow[65]) << nShift1) | (NeoSpreadBits(pRow[66]) << nShift2) | NeoSpreadBits(pRow[64]);
+		data[(y << 1) + 1] = (NeoSpreadBits(pRow[ 3]) << 3) | (NeoSpreadBits(pRow[ 1]) << nShift1) | (NeoSpreadBits(pRow[ 2]) << nShift2) | NeoSpreadBits(pRow[ 0]);
+	}
 
-			for (INT32 x = 0; x < 8; x++) {
-				UINT32 m = ((pTile[67 + (y << 2)] >> x) & 1) << 3;
-				m |= ((pTile[66 + (y << 2)] >> x) & 1) << 2;
-				m |= ((pTile[65 + (y << 2)] >> x) & 1) << 1;
-				m |= ((pTile[64 + (y << 2)] >> x) & 1) << 0;
+	for (INT32 n = 0; n < 32; n++) {
+		((UINT32*)pDest)[n] = data[n];
+	}
+}
+#endif
 
-				n |= m << (x << 2);
-			}
-			data[(y << 1) + 0] = n;
+// The data is converted in eight slices, each on its own thread if possible
+struct NeoDecodeSpritesJob {
+	UINT8* pData;
+	UINT8* pDest;
+	INT32 nSliceSize;
+	INT32 nSize;
+	bool bCD;
+};
 
-			n = 0;
-			for (INT32 x = 0; x < 8; x++) {
-				UINT32 m = ((pTile[3 + (y << 2)] >> x) & 1) << 3;
-				m |= ((pTile[2 + (y << 2)] >> x) & 1) << 2;
-				m |= ((pTile[1 + (y << 2)] >> x) & 1) << 1;
-				m |= ((pTile[0 + (y << 2)] >> x) & 1) << 0;
+static void NeoDecodeSpritesSlice(INT32 nSlice, void* pParam)
+{
+	NeoDecodeSpritesJob* pJob = (NeoDecodeSpritesJob*)pParam;
 
-				n |= m << (x << 2);
-			}
-			data[(y << 1) + 1] = n;
-		}
+	INT32 nStart = nSlice * pJob->nSliceSize;
+	INT32 nEnd = nStart + pJob->nSliceSize;
+	if (nEnd > pJob->nSize) {
+		nEnd = pJob->nSize;
+	}
 
-		for (INT32 n = 0; n < 32; n++) {
-			((UINT32*)pDest)[n] = data[n];
+	if (pJob->bCD) {
+		for (INT32 i = nStart; i < nEnd; i += 128) {
+			NeoDecodeTile(pJob->pData + i, pJob->pDest + i, 1, 2);
+		}
+	} else {
+		for (INT32 i = nStart; i < nEnd; i += 128) {
+			NeoDecodeTile(pJob->pData + i, pJob->pDest + i, 2, 1);
 		}
 	}
 }
+
+// ----------------------------------------------------------------------------
+// Graphics decoding for MVS/AES
+
+void NeoDecodeSprites(UINT8* pDest, INT32 nSize)
+{
+	NeoDecodeSpritesJob Job;
+
+	INT32 nStep = 8;
+	if (BurnDrvGetHardwareCode() & (HARDWARE_SNK_CMC42 | HARDWARE_SNK_CMC50))
+		nStep *= 4;
+	BurnUpdateProgress(8.0 / nStep, _T("Preprocessing graphics..."), 0);
+
+	// Pre-process the sprite graphics
+	Job.pData      = pDest;
+	Job.pDest      = pDest;
+	Job.nSliceSize = nSize >> 3;
+	Job.nSize      = nSize;
+	Job.bCD        = false;
+
+	BurnThreadRun(NeoDecodeSpritesSlice, &Job, 8);
+}
+
+// ----------------------------------------------------------------------------
+// Graphics decoding for Neo CD
+#ifdef WANT_NEOGEOCD
+void NeoDecodeSpritesCD(UINT8* pData, UINT8* pDest, INT32 nSize)
+{
+	NeoDecodeSpritesJob Job;
+
+	Job.pData      = pData;
+	Job.pDest      = pDest;
+	Job.nSliceSize = ((nSize >> 3) + 127) & ~127;
+	Job.nSize      = nSize;
+	Job.bCD        = true;
+
+	BurnThreadRun(NeoDecodeSpritesSlice, &Job, 8);
+}
 #endif
 // ----------------------------------------------------------------------------
 
@@ -42,6 +42,7 @@ extern NEO_CALLBACK* NeoCallbackActive;
 // neogeo.cpp
 void NeoClearScreen();
 INT32 NeoLoadCode(INT32 nOffset, INT32 nNum, UINT8* pDest);
+UINT8* NeoMapCode(INT32 nOffset, INT32 nNum, UINT32 nLen);
 INT32 NeoLoadSprites(INT32 nOffset, INT32 nNum, UINT8* pDest, UINT32 nSpriteSize);
 INT32 NeoLoadADPCM(INT32 nOffset, INT32 nNum, UINT8* pDest);
 
@@ -149,6 +150,38 @@ INT32 NeoInitSprites(INT32 nSlot);
 void NeoExitSprites(INT32 nSlot);
 INT32 NeoRenderSprites();
 
+void NeoBuildTileAttrib(UINT8* pDest, UINT8* pSprites, INT32 nMaxTile, UINT32 nSize);
+
+// neo_romcache.cpp
+// The Wii build has its own VM backed cache (see InitCache() in neo_run.cpp)
+#if !defined WII_VM
+ #define NEO_ROM_CACHE
+#endif
+
+#if defined NEO_ROM_CACHE
+enum {
+	NEO_CACHE_68K = 0,
+	NEO_CACHE_Z80,
+	NEO_CACHE_SPRITES,
+	NEO_CACHE_TEXT,
+	NEO_CACHE_ADPCMA,
+	NEO_CACHE_ADPCMB,
+	NEO_CACHE_TILEATTRIB,
+	NEO_CACHE_REGIONS
+};
+
+extern char szNeoROMCachePath[1024];
+extern bool bNeoROMCacheShared;
+
+bool NeoROMCacheEnabled();
+INT32 NeoROMCacheOpen(INT32 nSlot);
+UINT8* NeoROMCacheLoad(INT32 nSlot, INT32 nRegion, UINT32 nLen);
+INT32 NeoROMCacheSave(INT32 nSlot, UINT8** pRegion, UINT32* nRegionLen);
+bool NeoROMCacheMapped(const UINT8* pData);
+void NeoROMCachePrefetch(const UINT8* pData, UINT32 nLen);
+void NeoROMCacheExit();
+#endif
+
 // neo_decrypt.cpp
 extern UINT8 nNeoProtectionXor;
 
@@ -163,6 +196,7 @@ void neogeo_cmc50_m1_decrypt();
 void uPD4990AExit();
 void uPD499ASetTicks(UINT32 nTicksPerSecond);
 INT32 uPD4990AInit(UINT32 nTicksPerSecond);
+void uPD4990ASetTime();
 void uPD4990AScan(INT32 nAction, INT32* pnMin);
 void uPD4990AUpdate(UINT32 nTicks);
 void uPD4990AWrite(UINT8 CLK, UINT8 STB, UINT8 DATA);
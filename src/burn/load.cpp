@@ -1,6 +1,39 @@
 // Burn - Rom Loading module
 #include "burnint.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+ #define BURN_MAP_ROMS
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+struct BurnLoadRomScatter {
+   UINT8 *Dest;
+   INT32 nLen;
+   INT32 nGap;
+};
+
+// Insert one block of the rom into Dest with a gap of 'nGap' between each byte
+static INT32 BurnLoadRomScatterChunk(UINT8 *pData, INT32 nOffset, INT32 nLen, void *pParam)
+{
+   BurnLoadRomScatter *ps = (BurnLoadRomScatter *)pParam;
+
+   if (nOffset >= ps->nLen) return 0;
+   if (nLen > ps->nLen - nOffset) nLen = ps->nLen - nOffset;
+
+   UINT8 *pd = ps->Dest + nOffset * ps->nGap;
+   UINT8 *pl = pData, *LoadEnd = pData + nLen;
+
+   while (pl < LoadEnd)
+   {
+      *pd = *pl++; pd += ps->nGap;
+   }
+
+   return 0;
+}
+
 // Load a rom and separate out the bytes by nGap
 // Dest is the memory block to insert the rom into
 INT32 BurnLoadRom(UINT8 *Dest, INT32 i, INT32 nGap)
@@ -23,7 +56,18 @@ INT32 BurnLoadRom(UINT8 *Dest, INT32 i, INT32 nGap)
 
    if (nLen<=0) return 1;
 
-   if (nGap>1)
+   if (nGap>1 && BurnExtLoadRomChunked != NULL)
+   {
+      // Stream the rom straight into Dest, no need for a buffer the size of the whole rom
+      BurnLoadRomScatter Scatter;
+      Scatter.Dest=Dest;
+      Scatter.nLen=nLen;
+      Scatter.nGap=nGap;
+
+      nRet=BurnExtLoadRomChunked(i,NULL,BurnLoadRomScatterChunk,&Scatter);
+      if (nRet!=0) return 1;
+   }
+   else if (nGap>1)
    {
       UINT8 *Load=NULL;
       UINT8 *pd=NULL,*pl=NULL,*LoadEnd=NULL;
@@ -65,3 +109,91 @@ INT32 BurnLoadRom(UINT8 *Dest, INT32 i, INT32 nGap)
 
    return 0;
 }
+
+#if defined BURN_MAP_ROMS
+
+#define BURN_MAP_MAX (16)
+
+// x86 doesn't mind the rom starting at an odd address, elsewhere the cpu cores need aligned words
+#if defined(__i386__) || defined(__x86_64__)
+ #define BURN_MAP_ALIGN (1)
+#else
+ #define BURN_MAP_ALIGN (4)
+#endif
+
+struct BurnMappedRom {
+   void *pMap;
+   size_t nLen;
+};
+
+static BurnMappedRom MappedRom[BURN_MAP_MAX];
+static INT32 nMappedRoms = 0;
+
+#endif
+
+// Map rom i copy-on-write straight from its archive, if the application reports it is stored uncompressed
+// there. The pages come from the page cache (and are shared with any other process using the same
+// archive) until the driver writes to them. Returns NULL if the rom can't be mapped, load it as usual then.
+// Mapped roms are not known to BurnFree(), they are unmapped in BurnDrvExit()
+UINT8 *BurnMapRom(INT32 i)
+{
+#if defined BURN_MAP_ROMS
+   static INT64 nPageMask = 0;
+   struct BurnRomInfo ri;
+   struct stat st;
+   char szFile[1024];
+   INT64 nOffset = 0, nStart;
+   size_t nMapLen;
+   void *pMap;
+   INT32 fd;
+
+   if (BurnExtFindStoredRom == NULL || nMappedRoms >= BURN_MAP_MAX) return NULL;
+
+   ri.nType=0;
+   ri.nLen=0;
+   BurnDrvGetRomInfo(&ri,i);
+   if (ri.nType==0 || ri.nLen<=0) return NULL;
+
+   if (BurnExtFindStoredRom(i,szFile,sizeof(szFile),&nOffset)) return NULL;
+   if (nOffset & (BURN_MAP_ALIGN - 1)) return NULL;
+
+   if (nPageMask == 0) nPageMask = sysconf(_SC_PAGESIZE) - 1;
+
+   // mmap() wants a page aligned offset, map from the start of the page the rom begins in
+   nStart = nOffset & ~nPageMask;
+   nMapLen = (size_t)(nOffset - nStart) + ri.nLen;
+
+   fd = open(szFile, O_RDONLY);
+   if (fd < 0) return NULL;
+
+   // Touching a mapped page past the end of the file raises SIGBUS, so don't trust a truncated archive
+   if (fstat(fd, &st) != 0 || (INT64)st.st_size < nOffset + ri.nLen)
+   {
+      close(fd);
+      return NULL;
+   }
+
+   pMap = mmap(NULL, nMapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)nStart);
+   close(fd);
+
+   if (pMap == MAP_FAILED) return NULL;
+
+   MappedRom[nMappedRoms].pMap = pMap;
+   MappedRom[nMappedRoms].nLen = nMapLen;
+   nMappedRoms++;
+
+   return (UINT8 *)pMap + (nOffset - nStart);
+#else
+   (void)i;
+   return NULL;
+#endif
+}
+
+void BurnUnmapRoms()
+{
+#if defined BURN_MAP_ROMS
+   for (INT32 i = 0; i < nMappedRoms; i++)
+      munmap(MappedRom[i].pMap, MappedRom[i].nLen);
+   nMappedRoms = 0;
+#endif
+}
@@ -301,6 +301,172 @@ INT32 AY8910Read(INT32 chip)
 	return AYReadReg(chip,PSG->register_latch);
 }
 
+/* advance the envelope generator by one output sample */
+INLINE void AYStepEnvelope(struct AY8910 *PSG)
+{
+	if (PSG->Holding == 0)
+	{
+		PSG->CountE -= STEP;
+		if (PSG->CountE <= 0)
+		{
+			do
+			{
+				PSG->CountEnv--;
+				PSG->CountE += PSG->PeriodE;
+			} while (PSG->CountE <= 0);
+
+			/* check envelope current position */
+			if (PSG->CountEnv < 0)
+			{
+				if (PSG->Hold)
+				{
+					if (PSG->Alternate)
+						PSG->Attack ^= 0x1f;
+					PSG->Holding = 1;
+					PSG->CountEnv = 0;
+				}
+				else
+				{
+					/* if CountEnv has looped an odd number of times (usually 1), */
+					/* invert the output. */
+					if (PSG->Alternate && (PSG->CountEnv & 0x20))
+ 							PSG->Attack ^= 0x1f;
+
+					PSG->CountEnv &= 0x1f;
+				}
+			}
+
+			PSG->VolE = PSG->VolTable[PSG->CountEnv ^ PSG->Attack];
+			/* reload volume */
+			if (PSG->EnvelopeA) PSG->VolA = PSG->VolE;
+			if (PSG->EnvelopeB) PSG->VolB = PSG->VolE;
+			if (PSG->EnvelopeC) PSG->VolC = PSG->VolE;
+		}
+	}
+}
+
+/* Render a span of one channel whose output does not depend on the noise */
+/* generator (noise disabled for the channel, or fixed volume 0). Between */
+/* two edges of the square wave every sample has the same value, so whole */
+/* runs are filled at once and only samples containing an edge are */
+/* integrated. A disabled tone never reaches an edge (see AY8910Update). */
+INLINE void AYRenderToneSpan(INT32 *Count, UINT8 *Output, INT32 Period, UINT32 Vol, INT16 *buf, INT32 length)
+{
+	if (Vol == 0)
+	{
+		/* silent: only the counter has to advance */
+		memset(buf, 0, length * sizeof(INT16));
+
+		*Count -= length * STEP;
+		while (*Count <= 0)
+		{
+			*Count += Period;
+			if (*Count > 0)
+			{
+				*Output ^= 1;
+				break;
+			}
+			*Count += Period;
+		}
+		return;
+	}
+
+	while (length)
+	{
+		INT32 run = (*Count - 1) / STEP;
+		INT32 vol;
+
+		if (run > length) run = length;
+
+		if (run)
+		{
+			INT16 out = *Output ? Vol : 0;
+			INT32 i;
+
+			for (i = 0; i < run; i++)
+				buf[i] = out;
+
+			*Count -= run * STEP;
+			buf += run;
+			length -= run;
+			if (length == 0) break;
+		}
+
+		/* the next sample contains at least one edge */
+		vol = 0;
+		if (*Output) vol += *Count;
+		*Count -= STEP;
+		while (*Count <= 0)
+		{
+			*Count += Period;
+			if (*Count > 0)
+			{
+				*Output ^= 1;
+				if (*Output) vol += Period;
+				break;
+			}
+			*Count += Period;
+			vol += Period;
+		}
+		if (*Output) vol -= *Count;
+
+		*(buf++) = (vol * Vol) / STEP;
+		length--;
+	}
+}
+
+/* Fast path for AY8910Update(), used when no audible channel mixes in the */
+/* noise generator. Each channel is rendered on its own in spans between */
+/* envelope steps, and the noise generator is advanced in one go. The output */
+/* and the chip state are identical to the generic loop. */
+static void AYUpdateFast(struct AY8910 *PSG, INT16 *buf1, INT16 *buf2, INT16 *buf3, INT32 length)
+{
+	/* advance the noise generator over the whole update */
+	PSG->CountN -= length * STEP;
+	while (PSG->CountN <= 0)
+	{
+		if ((PSG->RNG + 1) & 2)
+			PSG->OutputN = ~PSG->OutputN;
+		if (PSG->RNG & 1) PSG->RNG ^= 0x24000;
+		PSG->RNG >>= 1;
+		PSG->CountN += PSG->PeriodN;
+	}
+
+	while (length)
+	{
+		INT32 span = length;
+
+		/* the volumes stay constant until the next envelope step */
+		if (PSG->Holding == 0)
+		{
+			INT32 next = (PSG->CountE + STEP - 1) / STEP - 1;
+			if (next < span) span = next;
+			PSG->CountE -= span * STEP;
+		}
+
+		if (span)
+		{
+			AYRenderToneSpan(&PSG->CountA, &PSG->OutputA, PSG->PeriodA, PSG->VolA, buf1, span);
+			AYRenderToneSpan(&PSG->CountB, &PSG->OutputB, PSG->PeriodB, PSG->VolB, buf2, span);
+			AYRenderToneSpan(&PSG->CountC, &PSG->OutputC, PSG->PeriodC, PSG->VolC, buf3, span);
+
+			buf1 += span;
+			buf2 += span;
+			buf3 += span;
+			length -= span;
+			if (length == 0) break;
+		}
+
+		/* the envelope steps during this sample; it uses the new volume */
+		AYStepEnvelope(PSG);
+
+		AYRenderToneSpan(&PSG->CountA, &PSG->OutputA, PSG->PeriodA, PSG->VolA, buf1++, 1);
+		AYRenderToneSpan(&PSG->CountB, &PSG->OutputB, PSG->PeriodB, PSG->VolB, buf2++, 1);
+		AYRenderToneSpan(&PSG->CountC, &PSG->OutputC, PSG->PeriodC, PSG->VolC, buf3++, 1);
+		length--;
+	}
+}
+
 void AY8910Update(INT32 chip, INT16 **buffer, INT32 length)
 {
 	struct AY8910 *PSG = &AYPSG[chip];
@@ -360,6 +526,16 @@ void AY8910Update(INT32 chip, INT16 **buffer, INT32 length)
 	if ((PSG->Regs[AY_ENABLE] & 0x38) == 0x38)	/* all off */
 		if (PSG->CountN <= length*STEP) PSG->CountN += length*STEP;
 
+	/* Channels that are either muted or not mixed with the noise generator */
+	/* (the usual case) don't need the generic loop below. */
+	if (((PSG->Regs[AY_ENABLE] & 0x08) || PSG->Regs[AY_AVOL] == 0) &&
+	    ((PSG->Regs[AY_ENABLE] & 0x10) || PSG->Regs[AY_BVOL] == 0) &&
+	    ((PSG->Regs[AY_ENABLE] & 0x20) || PSG->Regs[AY_CVOL] == 0))
+	{
+		AYUpdateFast(PSG, buf1, buf2, buf3, length);
+		return;
+	}
+
 	outn = (PSG->OutputN | PSG->Regs[AY_ENABLE]);
 
 
@@ -515,46 +691,7 @@ void AY8910Update(INT32 chip, INT16 **buffer, INT32 length)
 			left -= nextevent;
 		} while (left > 0);
 
-		/* update envelope */
-		if (PSG->Holding == 0)
-		{
-			PSG->CountE -= STEP;
-			if (PSG->CountE <= 0)
-			{
-				do
-				{
-					PSG->CountEnv--;
-					PSG->CountE += PSG->PeriodE;
-				} while (PSG->CountE <= 0);
-
-				/* check envelope current position */
-				if (PSG->CountEnv < 0)
-				{
-					if (PSG->Hold)
-					{
-						if (PSG->Alternate)
-							PSG->Attack ^= 0x1f;
-						PSG->Holding = 1;
-						PSG->CountEnv = 0;
-					}
-					else
-					{
-						/* if CountEnv has looped an odd number of times (usually 1), */
-						/* invert the output. */
-						if (PSG->Alternate && (PSG->CountEnv & 0x20))
- 							PSG->Attack ^= 0x1f;
-
-						PSG->CountEnv &= 0x1f;
-					}
-				}
-
-				PSG->VolE = PSG->VolTable[PSG->CountEnv ^ PSG->Attack];
-				/* reload volume */
-				if (PSG->EnvelopeA) PSG->VolA = PSG->VolE;
-				if (PSG->EnvelopeB) PSG->VolB = PSG->VolE;
-				if (PSG->EnvelopeC) PSG->VolC = PSG->VolE;
-			}
-		}
+		AYStepEnvelope(PSG);
 
 		*(buf1++) = (vola * PSG->VolA) / STEP;
 		*(buf2++) = (volb * PSG->VolB) / STEP;
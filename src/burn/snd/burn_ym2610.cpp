@@ -2,6 +2,10 @@
 #include "burn_sound.h"
 #include "burn_ym2610.h"
 
+#if defined BURN_YM2610_TRACE
+ #include <stdio.h>
+#endif
+
 void (*BurnYM2610Update)(INT16* pSoundBuf, INT32 nSegmentEnd);
 
 static INT32 (*BurnYM2610StreamCallback)(INT32 nSoundRate);
@@ -25,6 +29,49 @@ static INT32 YM2610RouteDirs[3];
 static double YM2610LeftVolumes[3];
 static double YM2610RightVolumes[3];
 
+#if defined BURN_YM2610_TRACE
+static FILE* fYM2610Trace = NULL;
+
+static void YM2610TraceWriteLong(UINT32 nValue)
+{
+	UINT8 b[4] = { (UINT8)nValue, (UINT8)(nValue >> 8), (UINT8)(nValue >> 16), (UINT8)(nValue >> 24) };
+
+	fwrite(b, 1, 4, fYM2610Trace);
+}
+
+static void YM2610TraceRecord(UINT32 nTime, INT32 a, INT32 n)
+{
+	UINT8 b[4] = { (UINT8)a, (UINT8)n, 0, 0 };
+
+	if (fYM2610Trace) {
+		YM2610TraceWriteLong(nTime);
+		fwrite(b, 1, 4, fYM2610Trace);
+	}
+}
+
+static void YM2610TraceOpen(INT32 nClockFrequency)
+{
+	const char* pszName = getenv("BURN_YM2610_TRACE");
+
+	if (pszName == NULL || (fYM2610Trace = fopen(pszName, "wb")) == NULL) {
+		return;
+	}
+
+	fwrite(BURN_YM2610_TRACE_MAGIC, 1, 4, fYM2610Trace);
+	YM2610TraceWriteLong(nClockFrequency);
+	YM2610TraceWriteLong(nBurnFPS);
+}
+
+void BurnYM2610TraceWrite(INT32 a, INT32 n)
+{
+	if (fYM2610Trace) {
+		YM2610TraceRecord(BurnYM2610StreamCallback(BURN_YM2610_TRACE_RATE), a, n);
+	}
+
+	YM2610Write(0, a, n);
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // Dummy functions
 
@@ -67,7 +114,8 @@ static void YM2610Render(INT32 nSegmentLength)
 	pYM2610Buffer[0] = pBuffer + 0 * 4096 + 4 + nYM2610Position;
 	pYM2610Buffer[1] = pBuffer + 1 * 4096 + 4 + nYM2610Position;
 
-	YM2610UpdateOne(0, &pYM2610Buffer[0], nSegmentLength);
+	// Without output the chip still has to run, its timers, status and ADPCM end flags are visible to the Z80
+	YM2610UpdateOne(0, bBurnNoRender ? NULL : &pYM2610Buffer[0], nSegmentLength);
 
 	nYM2610Position += nSegmentLength;
 }
@@ -102,8 +150,17 @@ static void YM2610UpdateResample(INT16* pSoundBuf, INT32 nSegmentEnd)
 	pYM2610Buffer[4] = pBuffer + 4 * 4096 + 4;
 	pYM2610Buffer[5] = pBuffer + 5 * 4096 + 4;
 
-	for (INT32 i = (nFractionalPosition >> 16) - 4; i < nSamplesNeeded; i++) {
-		pYM2610Buffer[5][i] = BURN_SND_CLIP(pYM2610Buffer[2][i] + pYM2610Buffer[3][i] + pYM2610Buffer[4][i]);
+	if (bBurnNoRender) {
+		// Only move the position on, as the loop below would
+		INT32 i = (nFractionalPosition & 0xFFFF0000) >> 15;
+		if (i < nSegmentLength) {
+			nFractionalPosition += ((nSegmentLength - i + 1) >> 1) * nSampleSize;
+		}
+		nSegmentLength = 0;
+	} else {
+		for (INT32 i = (nFractionalPosition >> 16) - 4; i < nSamplesNeeded; i++) {
+			pYM2610Buffer[5][i] = BURN_SND_CLIP(pYM2610Buffer[2][i] + pYM2610Buffer[3][i] + pYM2610Buffer[4][i]);
+		}
 	}
 
    for (INT32 i = (nFractionalPosition & 0xFFFF0000) >> 15; i < nSegmentLength; i += 2, nFractionalPosition += nSampleSize)
@@ -178,6 +235,10 @@ static void YM2610UpdateResample(INT16* pSoundBuf, INT32 nSegmentEnd)
 		nAY8910Position = nExtraSamples;
 
 		dTime += 100.0 / nBurnFPS;
+
+#if defined BURN_YM2610_TRACE
+		YM2610TraceRecord(BURN_YM2610_TRACE_FRAME, 0, 0);
+#endif
 	}
 }
 
@@ -202,6 +263,10 @@ static void YM2610UpdateNormal(INT16* pSoundBuf, INT32 nSegmentEnd)
 	pYM2610Buffer[3] = pBuffer + 4 + 3 * 4096;
 	pYM2610Buffer[4] = pBuffer + 4 + 4 * 4096;
 
+	if (bBurnNoRender) {
+		nFractionalPosition = nSegmentLength;
+	}
+
    for (INT32 n = nFractionalPosition; n < nSegmentLength; n++)
    {
       INT32 nAYSample, nLeftSample = 0, nRightSample = 0;
@@ -257,6 +322,10 @@ static void YM2610UpdateNormal(INT16* pSoundBuf, INT32 nSegmentEnd)
 		nAY8910Position = nExtraSamples;
 
 		dTime += 100.0 / nBurnFPS;
+
+#if defined BURN_YM2610_TRACE
+		YM2610TraceRecord(BURN_YM2610_TRACE_FRAME, 0, 0);
+#endif
 	}
 }
 
@@ -298,6 +367,13 @@ void BurnYM2610Exit(void)
 		free(pAYBuffer);
 		pAYBuffer = NULL;
 	}
+
+#if defined BURN_YM2610_TRACE
+	if (fYM2610Trace) {
+		fclose(fYM2610Trace);
+		fYM2610Trace = NULL;
+	}
+#endif
 }
 
 void BurnYM2610MapADPCMROM(UINT8* YM2610ADPCMAROM, INT32 nYM2610ADPCMASize, UINT8* YM2610ADPCMBROM, INT32 nYM2610ADPCMBSize)
@@ -351,6 +427,10 @@ INT32 BurnYM2610Init(INT32 nClockFrequency, UINT8* YM2610ADPCMAROM, INT32* nYM26
 	nAY8910Position = 0;
 
 	nFractionalPosition = 0;
+
+#if defined BURN_YM2610_TRACE
+	YM2610TraceOpen(nClockFrequency);
+#endif
 	
 	// default routes
 	YM2610Volumes[BURN_SND_YM2610_YM2610_ROUTE_1] = 1.00;
@@ -388,11 +468,16 @@ void BurnYM2610SetRightVolume(INT32 nIndex, double nRightVolume)
 
 void BurnYM2610Scan(INT32 nAction, INT32* pnMin)
 {
+	if (pnMin && *pnMin < 0x029732) {				// nFractionalPosition is saved since 0.2.97.32
+		*pnMin = 0x029732;
+	}
+
 	BurnTimerScan(nAction, pnMin);
 	AY8910Scan(nAction, pnMin);
 
 	if (nAction & ACB_DRIVER_DATA) {
 		SCAN_VAR(nYM2610Position);
 		SCAN_VAR(nAY8910Position);
+		SCAN_VAR(nFractionalPosition);
 	}
 }
@@ -28,4 +28,21 @@ void BurnYM2610Scan(INT32 nAction, INT32* pnMin);
 	BurnYM2610SetRoute(BURN_SND_YM2610_AY8910_ROUTE  , v, d);
 	
 #define BurnYM2610Read(a) YM2610Read(0, a)
+
+// Register write traces, replayed by the ym2610bench tool (src/burner/tools).
+// A trace is the header followed by 8-byte records (all little endian):
+// UINT32 time since the start of the frame in 1/BURN_YM2610_TRACE_RATE s
+// (BURN_YM2610_TRACE_FRAME marks the end of a frame), UINT8 port, UINT8 data
+// and two bytes of padding. The header is the magic, the chip clock and
+// nBurnFPS as UINT32s.
+#define BURN_YM2610_TRACE_MAGIC		"YMT1"
+#define BURN_YM2610_TRACE_RATE		1000000
+#define BURN_YM2610_TRACE_FRAME		0xFFFFFFFF
+
+#if defined BURN_YM2610_TRACE
+// Capture to the file named by the BURN_YM2610_TRACE environment variable
+void BurnYM2610TraceWrite(INT32 a, INT32 n);
+#define BurnYM2610Write(a, n) BurnYM2610TraceWrite(a, n)
+#else
 #define BurnYM2610Write(a, n) YM2610Write(0, a, n)
+#endif
@@ -1474,6 +1474,29 @@ INLINE void update_phase_lfo_channel(FM_OPN *OPN, FM_CH *CH)
 	}
 }
 
+INLINE void chan_update_phase(FM_OPN *OPN, FM_CH *CH, int chnum)
+{
+	if(CH->pms)
+	{
+		/* add support for 3 slot mode */
+		if ((OPN->ST.mode & 0xC0) && (chnum == 2))
+		{
+		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT1], CH->pms, OPN->SL3.block_fnum[1]);
+		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT2], CH->pms, OPN->SL3.block_fnum[2]);
+		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT3], CH->pms, OPN->SL3.block_fnum[0]);
+		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT4], CH->pms, CH->block_fnum);
+		}
+		else update_phase_lfo_channel(OPN, CH);
+	}
+	else	/* no LFO phase modulation */
+	{
+		CH->SLOT[SLOT1].phase += CH->SLOT[SLOT1].Incr;
+		CH->SLOT[SLOT2].phase += CH->SLOT[SLOT2].Incr;
+		CH->SLOT[SLOT3].phase += CH->SLOT[SLOT3].Incr;
+		CH->SLOT[SLOT4].phase += CH->SLOT[SLOT4].Incr;
+	}
+}
+
 INLINE void chan_calc(FM_OPN *OPN, FM_CH *CH, int chnum)
 {
 	unsigned int eg_out;
@@ -1527,25 +1550,32 @@ INLINE void chan_calc(FM_OPN *OPN, FM_CH *CH, int chnum)
 	CH->mem_value = mem;
 
 	/* update phase counters AFTER output calculations */
-	if(CH->pms)
-	{
-		/* add support for 3 slot mode */
-		if ((OPN->ST.mode & 0xC0) && (chnum == 2))
-		{
-		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT1], CH->pms, OPN->SL3.block_fnum[1]);
-		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT2], CH->pms, OPN->SL3.block_fnum[2]);
-		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT3], CH->pms, OPN->SL3.block_fnum[0]);
-		        update_phase_lfo_slot(OPN, &CH->SLOT[SLOT4], CH->pms, CH->block_fnum);
-		}
-		else update_phase_lfo_channel(OPN, CH);
-	}
-	else	/* no LFO phase modulation */
+	chan_update_phase(OPN, CH, chnum);
+}
+
+/* advance a channel by one sample without calculating its output.
+   Only what is kept in the save state moves on: the SLOT1 feedback
+   and the phase counters. */
+INLINE void chan_advance(FM_OPN *OPN, FM_CH *CH, int chnum)
+{
+	unsigned int eg_out;
+
+	UINT32 AM = LFO_AM >> CH->ams;
+
+	INT32 out = CH->op1_out[0] + CH->op1_out[1];
+	CH->op1_out[0] = CH->op1_out[1];
+
+	CH->op1_out[1] = 0;
+	eg_out = volume_calc(&CH->SLOT[SLOT1]);
+	if( eg_out < ENV_QUIET )	/* SLOT 1 */
 	{
-		CH->SLOT[SLOT1].phase += CH->SLOT[SLOT1].Incr;
-		CH->SLOT[SLOT2].phase += CH->SLOT[SLOT2].Incr;
-		CH->SLOT[SLOT3].phase += CH->SLOT[SLOT3].Incr;
-		CH->SLOT[SLOT4].phase += CH->SLOT[SLOT4].Incr;
+		if (!CH->FB)
+			out=0;
+
+		CH->op1_out[1] = op_calc1(CH->SLOT[SLOT1].phase, eg_out, (out<<CH->FB) );
 	}
+
+	chan_update_phase(OPN, CH, chnum);
 }
 
 /* update phase increment and envelope generator */
@@ -2281,6 +2311,8 @@ INLINE void ADPCMA_calc_chan( YM2610 *F2610, ADPCM_CH *ch )
 }
 
 /* ADPCM type A Write */
+void (*YM2610ADPCMAPrefetch)(const UINT8 *data, UINT32 length) = NULL;
+
 static void FM_ADPCMAWrite(YM2610 *F2610,int r,int v)
 {
 	ADPCM_CH *adpcm = F2610->adpcm;
@@ -2311,6 +2343,13 @@ static void FM_ADPCMAWrite(YM2610 *F2610,int r,int v)
                {
 						if(adpcm[c].start >= F2610->pcm_size)	/* Check Start in Range */
 							adpcm[c].flag = 0;
+						else if(YM2610ADPCMAPrefetch)
+						{
+							UINT32 end = adpcm[c].end + 1;
+							if(end > F2610->pcm_size || end < adpcm[c].start)
+								end = F2610->pcm_size;
+							YM2610ADPCMAPrefetch(F2610->pcmbuf + adpcm[c].start, end - adpcm[c].start);
+						}
 					}
 				}
 			}
@@ -2423,10 +2462,13 @@ void YM2610UpdateOne(int num, INT16 **buffer, int length)
 	YM_DELTAT *DELTAT = &(F2610[num].deltaT);
 	int i,j;
 	FMSAMPLE  *bufL,*bufR;
+	INT32 deltat_buf[YM_DELTAT_BLOCK_SIZE];
+	int deltat_pos = 0, deltat_len = 0;
+	int deltat_on = DELTAT->portstate&0x80;
 
-	/* buffer setup */
-	bufL = buffer[0];
-	bufR = buffer[1];
+	/* buffer setup, no buffer just advances the chip */
+	bufL = buffer ? buffer[0] : NULL;
+	bufR = buffer ? buffer[1] : NULL;
 
 	if( (void *)F2610 != cur_chip ){
 		cur_chip = (void *)F2610;
@@ -2486,14 +2528,33 @@ void YM2610UpdateOne(int num, INT16 **buffer, int length)
 		}
 
 		/* calculate FM */
-		chan_calc(OPN, cch[0], 1 );	/*remapped to 1*/
-		chan_calc(OPN, cch[1], 2 );	/*remapped to 2*/
-		chan_calc(OPN, cch[2], 4 );	/*remapped to 4*/
-		chan_calc(OPN, cch[3], 5 );	/*remapped to 5*/
+		if( bufL )
+		{
+			chan_calc(OPN, cch[0], 1 );	/*remapped to 1*/
+			chan_calc(OPN, cch[1], 2 );	/*remapped to 2*/
+			chan_calc(OPN, cch[2], 4 );	/*remapped to 4*/
+			chan_calc(OPN, cch[3], 5 );	/*remapped to 5*/
+		}
+		else
+		{
+			chan_advance(OPN, cch[0], 1 );
+			chan_advance(OPN, cch[1], 2 );
+			chan_advance(OPN, cch[2], 4 );
+			chan_advance(OPN, cch[3], 5 );
+		}
 
-		/* deltaT ADPCM */
-		if( DELTAT->portstate&0x80 )
-			YM_DELTAT_ADPCM_CALC(DELTAT);
+		/* deltaT ADPCM, decoded a block at a time */
+		if( deltat_on )
+		{
+			if( deltat_pos == deltat_len )
+			{
+				deltat_len = length - i;
+				if( deltat_len > YM_DELTAT_BLOCK_SIZE ) deltat_len = YM_DELTAT_BLOCK_SIZE;
+				YM_DELTAT_ADPCM_CALC_BLOCK(DELTAT, deltat_buf, deltat_len);
+				deltat_pos = 0;
+			}
+			*(DELTAT->pan) += deltat_buf[deltat_pos++];
+		}
 
 		/* ADPCMA */
 		for( j = 0; j < 6; j++ )
@@ -2503,6 +2564,7 @@ void YM2610UpdateOne(int num, INT16 **buffer, int length)
 		}
 
 		/* buffering */
+		if( bufL )
 		{
 			int lt,rt;
 
@@ -2554,6 +2616,9 @@ void YM2610BUpdateOne(int num, INT16 **buffer, int length)
 	YM_DELTAT *DELTAT = &(FM2610[num].deltaT);
 	int i,j;
 	FMSAMPLE  *bufL,*bufR;
+	INT32 deltat_buf[YM_DELTAT_BLOCK_SIZE];
+	int deltat_pos = 0, deltat_len = 0;
+	int deltat_on = DELTAT->portstate&0x80;
 
 	/* buffer setup */
 	bufL = buffer[0];
@@ -2632,9 +2697,18 @@ void YM2610BUpdateOne(int num, INT16 **buffer, int length)
 		chan_calc(OPN, cch[4], 4 );
 		chan_calc(OPN, cch[5], 5 );
 
-		/* deltaT ADPCM */
-		if( DELTAT->portstate&0x80 )
-			YM_DELTAT_ADPCM_CALC(DELTAT);
+		/* deltaT ADPCM, decoded a block at a time */
+		if( deltat_on )
+		{
+			if( deltat_pos == deltat_len )
+			{
+				deltat_len = length - i;
+				if( deltat_len > YM_DELTAT_BLOCK_SIZE ) deltat_len = YM_DELTAT_BLOCK_SIZE;
+				YM_DELTAT_ADPCM_CALC_BLOCK(DELTAT, deltat_buf, deltat_len);
+				deltat_pos = 0;
+			}
+			*(DELTAT->pan) += deltat_buf[deltat_pos++];
+		}
 
 		/* ADPCMA */
 		for( j = 0; j < 6; j++ )
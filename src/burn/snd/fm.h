@@ -173,6 +173,7 @@ void YM2610SetRom(int num,
 				void *pcmroma,int pcmsizea,void *pcmromb,int pcmsizeb);
 void YM2610Shutdown(void);
 void YM2610ResetChip(int num);
+/* A NULL buffer runs the chip for length samples without producing any sound */
 void YM2610UpdateOne(int num, INT16 **buffer, int length);
 #if BUILD_YM2610B
 void YM2610BUpdateOne(int num, INT16 **buffer, int length);
@@ -181,6 +182,10 @@ void YM2610BUpdateOne(int num, INT16 **buffer, int length);
 int YM2610Write(int n, int a,unsigned char v);
 unsigned char YM2610Read(int n,int a);
 int YM2610TimerOver(int n, int c );
+
+/* Optional, called at ADPCM-A key on with the part of the ROM the channel is about to play,
+   so ROM data that is paged in on demand can be read ahead */
+extern void (*YM2610ADPCMAPrefetch)(const UINT8 *data, UINT32 length);
 #endif /* BUILD_YM2610 */
 
 #if BUILD_YM2612
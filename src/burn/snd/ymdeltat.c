@@ -521,9 +521,6 @@ INLINE void YM_DELTAT_synthesis_from_external_memory(YM_DELTAT *DELTAT)
 	DELTAT->adpcml = DELTAT->prev_acc * (int)((1<<YM_DELTAT_SHIFT)-DELTAT->now_step);
 	DELTAT->adpcml += (DELTAT->acc * (int)DELTAT->now_step);
 	DELTAT->adpcml = (DELTAT->adpcml>>YM_DELTAT_SHIFT) * (int)DELTAT->volume;
-
-	/* output for work of output channels (outd[OPNxxxx])*/
-	*(DELTAT->pan) += DELTAT->adpcml;
 }
 
 
@@ -579,9 +576,6 @@ INLINE void YM_DELTAT_synthesis_from_CPU_memory(YM_DELTAT *DELTAT)
 	DELTAT->adpcml = DELTAT->prev_acc * (int)((1<<YM_DELTAT_SHIFT)-DELTAT->now_step);
 	DELTAT->adpcml += (DELTAT->acc * (int)DELTAT->now_step);
 	DELTAT->adpcml = (DELTAT->adpcml>>YM_DELTAT_SHIFT) * (int)DELTAT->volume;
-
-	/* output for work of output channels (outd[OPNxxxx])*/
-	*(DELTAT->pan) += DELTAT->adpcml;
 }
 
 
@@ -606,6 +600,9 @@ value:   START, REC, MEMDAT, REPEAT, SPOFF, x,x,RESET   meaning:
 	if ( (DELTAT->portstate & 0xe0)==0xa0 )
 	{
 		YM_DELTAT_synthesis_from_external_memory(DELTAT);
+
+		/* output for work of output channels (outd[OPNxxxx])*/
+		*(DELTAT->pan) += DELTAT->adpcml;
 		return;
 	}
 
@@ -613,6 +610,9 @@ value:   START, REC, MEMDAT, REPEAT, SPOFF, x,x,RESET   meaning:
 	{
 		/* ADPCM synthesis from CPU-managed memory (from reg $08) */
 		YM_DELTAT_synthesis_from_CPU_memory(DELTAT);	/* change output based on data in ADPCM data reg ($08) */
+
+		/* output for work of output channels (outd[OPNxxxx])*/
+		*(DELTAT->pan) += DELTAT->adpcml;
 		return;
 	}
 
@@ -623,3 +623,155 @@ value:   START, REC, MEMDAT, REPEAT, SPOFF, x,x,RESET   meaning:
 	return;
 }
 
+
+/* Number of nibbles that can be decoded from 'addr' on before the address
+** has to be checked against the limit or end address, or wraps around.
+*/
+INLINE UINT32 YM_DELTAT_run_length(YM_DELTAT *DELTAT, UINT32 addr)
+{
+	UINT32 limit = DELTAT->limit<<1;
+	UINT32 end   = DELTAT->end<<1;
+	UINT32 run   = ((1<<(24+1))-1) - addr;
+
+	if ( limit >= addr && limit - addr < run ) run = limit - addr;
+	if ( end   >= addr && end   - addr < run ) run = end   - addr;
+
+	return run;
+}
+
+/* Block version of YM_DELTAT_synthesis_from_external_memory().
+** The state is kept in locals for the whole block and the limit/end/wrap
+** checks are only made on the nibbles where one of them can trigger.
+** Returns the number of samples produced before the sample ended.
+*/
+static int YM_DELTAT_synthesis_block_from_external_memory(YM_DELTAT *DELTAT, INT32 *buffer, int length)
+{
+	UINT8 *memory  = DELTAT->memory;
+	UINT32 addr    = DELTAT->now_addr;
+	UINT32 pos     = DELTAT->now_step;
+	UINT32 stepinc = DELTAT->step;
+	INT32 acc      = DELTAT->acc;
+	INT32 prev_acc = DELTAT->prev_acc;
+	INT32 adpcmd   = DELTAT->adpcmd;
+	INT32 volume   = DELTAT->volume;
+	UINT8 now_data = DELTAT->now_data;
+	UINT32 run     = YM_DELTAT_run_length(DELTAT, addr);
+	int i, data;
+
+	for (i = 0; i < length; i++)
+	{
+		pos += stepinc;
+		if ( pos >= (1<<YM_DELTAT_SHIFT) )
+		{
+			UINT32 step = pos >> YM_DELTAT_SHIFT;
+			pos &= (1<<YM_DELTAT_SHIFT)-1;
+
+			do{
+				if ( run == 0 )
+				{
+					if ( addr == (DELTAT->limit<<1) )
+						addr = 0;
+
+					if ( addr == (DELTAT->end<<1) ) {
+						if( DELTAT->portstate&0x10 ){
+							/* repeat start */
+							addr     = DELTAT->start<<1;
+							acc      = 0;
+							adpcmd   = YM_DELTAT_DELTA_DEF;
+							prev_acc = 0;
+						}else{
+							/* set EOS bit in status register */
+							if(DELTAT->status_set_handler)
+								if(DELTAT->status_change_EOS_bit)
+									(DELTAT->status_set_handler)(DELTAT->status_change_which_chip, DELTAT->status_change_EOS_bit);
+
+							/* clear PCM BUSY bit (reflected in status register) */
+							DELTAT->PCM_BSY = 0;
+
+							DELTAT->portstate = 0;
+							DELTAT->now_addr  = addr;
+							DELTAT->now_step  = pos;
+							DELTAT->acc       = acc;
+							DELTAT->adpcmd    = adpcmd;
+							DELTAT->now_data  = now_data;
+							DELTAT->adpcml    = 0;
+							DELTAT->prev_acc  = 0;
+
+							/* the sample that ends is silent */
+							buffer[i] = 0;
+							return i + 1;
+						}
+					}
+
+					/* this nibble is decoded without further checks, */
+					/* the run restarts at the next address */
+					run = 1;
+				}
+
+				if( addr&1 ) data = now_data & 0x0f;
+				else
+				{
+					now_data = memory[addr>>1];
+					data = now_data >> 4;
+				}
+
+				addr++;
+				addr &= ( (1<<(24+1))-1);
+				if ( --run == 0 )
+					run = YM_DELTAT_run_length(DELTAT, addr);
+
+				/* store accumulator value */
+				prev_acc = acc;
+
+				/* Forecast to next Forecast */
+				acc += (ym_deltat_decode_tableB1[data] * adpcmd / 8);
+				YM_DELTAT_Limit(acc,YM_DELTAT_DECODE_MAX, YM_DELTAT_DECODE_MIN);
+
+				/* delta to next delta */
+				adpcmd = (adpcmd * ym_deltat_decode_tableB2[data] ) / 64;
+				YM_DELTAT_Limit(adpcmd,YM_DELTAT_DELTA_MAX, YM_DELTAT_DELTA_MIN );
+
+			}while(--step);
+		}
+
+		/* ElSemi: Fix interpolator. */
+		buffer[i] = ((prev_acc * (int)((1<<YM_DELTAT_SHIFT)-pos) + acc * (int)pos)>>YM_DELTAT_SHIFT) * volume;
+	}
+
+	DELTAT->now_addr = addr;
+	DELTAT->now_step = pos;
+	DELTAT->acc      = acc;
+	DELTAT->prev_acc = prev_acc;
+	DELTAT->adpcmd   = adpcmd;
+	DELTAT->now_data = now_data;
+	if (length)
+		DELTAT->adpcml = buffer[length - 1];
+
+	return length;
+}
+
+/* ADPCM B (Delta-T control type), 'length' samples at once.
+** Writes the contribution of the unit for each sample to 'buffer' instead of
+** adding it to the output channel, so the caller can mix a whole block.
+** Samples after the end of the sample are 0.
+*/
+void YM_DELTAT_ADPCM_CALC_BLOCK(YM_DELTAT *DELTAT, INT32 *buffer, int length)
+{
+	int i = 0;
+
+	if ( (DELTAT->portstate & 0xe0)==0xa0 )
+	{
+		i = YM_DELTAT_synthesis_block_from_external_memory(DELTAT, buffer, length);
+	}
+	else if ( (DELTAT->portstate & 0xe0)==0x80 )
+	{
+		for (; i < length; i++)
+		{
+			YM_DELTAT_synthesis_from_CPU_memory(DELTAT);
+			buffer[i] = DELTAT->adpcml;
+		}
+	}
+
+	for (; i < length; i++)
+		buffer[i] = 0;
+}
@@ -3,6 +3,9 @@
 
 #define YM_DELTAT_SHIFT    (16)
 
+/* samples decoded per call of YM_DELTAT_ADPCM_CALC_BLOCK by the mixers */
+#define YM_DELTAT_BLOCK_SIZE	(256)
+
 #define YM_DELTAT_EMULATION_MODE_NORMAL	0
 #define YM_DELTAT_EMULATION_MODE_YM2610	1
 
@@ -69,6 +72,7 @@ UINT8 YM_DELTAT_ADPCM_Read(YM_DELTAT *DELTAT);
 void YM_DELTAT_ADPCM_Write(YM_DELTAT *DELTAT,int r,int v);
 void YM_DELTAT_ADPCM_Reset(YM_DELTAT *DELTAT,int pan,int emulation_mode);
 void YM_DELTAT_ADPCM_CALC(YM_DELTAT *DELTAT);
+void YM_DELTAT_ADPCM_CALC_BLOCK(YM_DELTAT *DELTAT, INT32 *buffer, int length);
 
 void YM_DELTAT_postload(YM_DELTAT *DELTAT,UINT8 *regs);
 void YM_DELTAT_savestate(const char *statename,int num,YM_DELTAT *DELTAT);
@@ -67,15 +67,59 @@ TCHAR* ExtractFilename(TCHAR* fullname);
 
 INT32 SetBurnHighCol(INT32 nDepth);
 
+// movie.cpp
+#define MOVIE_NONE			(0)
+#define MOVIE_RECORD		(1)
+#define MOVIE_PLAYBACK		(2)
+INT32 BurnMovieRecord(TCHAR* szName, INT32 bFromState);
+INT32 BurnMoviePlay(TCHAR* szName);
+void BurnMovieStop();
+INT32 BurnMovieFrame();
+INT32 BurnMovieStatus();
+void BurnMovieGetFrames(INT32* pnFrame, INT32* pnFrames);
+
+// rewind.cpp
+INT32 BurnRewindInit(INT32 nBudget);
+void BurnRewindExit();
+INT32 BurnRewindPush();
+INT32 BurnRewindStep();
+INT32 BurnRewindFrames();
+
+// rollback.cpp
+INT32 BurnRollbackInit(INT32 nSlots);
+void BurnRollbackExit();
+INT32 BurnRollbackSave(INT32 nFrame);
+INT32 BurnRollbackLoad(INT32 nFrame);
+INT32 BurnRollbackRun(INT32 nFrames, void (*pSetInputs)(INT32 nFrame));
+UINT32 BurnRollbackChecksum();
+
 // state.cpp
+extern INT32 nBurnStateCodec;
 INT32 BurnStateLoadEmbed(FILE* fp, INT32 nOffset, INT32 bAll, INT32 (*pLoadGame)());
 INT32 BurnStateLoad(TCHAR* szName, INT32 bAll, INT32 (*pLoadGame)());
 INT32 BurnStateSaveEmbed(FILE* fp, INT32 nOffset, INT32 bAll);
 INT32 BurnStateSave(TCHAR* szName, INT32 bAll);
+INT32 BurnStateSaveBackground(TCHAR* szName, INT32 bAll);
+INT32 BurnStateSaveDone();
+INT32 BurnStateSaveWait();
 
 // statec.cpp
-INT32 BurnStateCompress(UINT8** pDef, INT32* pnDefLen, INT32 bAll);
-INT32 BurnStateDecompress(UINT8* Def, INT32 nDefLen, INT32 bAll);
+#define BURN_STATE_DEFLATE	(0)
+#define BURN_STATE_FAST		(1)
+INT32 BurnStateSnapshot(UINT8** pRaw, INT32* pnRawLen, INT32 bAll);
+INT32 BurnStateCompressRaw(const UINT8* Raw, INT32 nRawLen, INT32 nCodec, UINT8** pDef, INT32* pnDefLen);
+INT32 BurnStateCompress(UINT8** pDef, INT32* pnDefLen, INT32 bAll, INT32 nCodec);
+INT32 BurnStateDecompress(UINT8* Def, INT32 nDefLen, INT32 bAll, INT32 nCodec);
+INT32 BurnStateFastBound(INT32 nSrcLen);
+INT32 BurnStateFastCompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest);
+INT32 BurnStateFastDecompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest, INT32 nDestLen);
+
+// statedelta.cpp
+INT32 BurnStateDeltaInit();
+void BurnStateDeltaExit();
+INT32 BurnStateDeltaSave(UINT8** pDelta, INT32* pnDeltaLen);
+INT32 BurnStateDeltaUndo(const UINT8* pDelta, INT32 nDeltaLen);
+INT32 BurnStateDeltaLoad();
 
 // zipfn.cpp
 struct ZipEntry { char* szName;	UINT32 nLen; UINT32 nCrc; };
@@ -84,4 +128,8 @@ INT32 ZipOpen(char* szZip);
 INT32 ZipClose();
 INT32 ZipGetList(struct ZipEntry** pList, INT32* pnListCount);
 INT32 ZipLoadFile(UINT8* Dest, INT32 nLen, INT32* pnWrote, INT32 nEntry);
+INT32 ZipGetStoredEntry(INT32 nEntry, char** pszZip, INT64* pnOffset);
+INT32 ZipLoadFileChunked(INT32 nLen, INT32* pnWrote, INT32 nEntry, BurnLoadRomChunk pChunk, void* pParam);
+struct ZipLoadRequest { UINT8* Dest; INT32 nLen; INT32 nEntry; INT32 nWrote; INT32 nRet; };
+INT32 ZipLoadFiles(struct ZipLoadRequest* pRequests, INT32 nCount);
 INT32 __cdecl ZipLoadOneFile(char* arcName, const char* fileName, void** Dest, INT32* pnWrote);
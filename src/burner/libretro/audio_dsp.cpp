@@ -0,0 +1,171 @@
+#include <stddef.h>
+
+#include "audio_dsp.h"
+
+/* Audio post-processing chain
+ *
+ * Every stage is a recursive filter, so there is no parallelism to
+ * extract across time and the two channels already run side by side.
+ * What costs is walking the buffer once per effect with a branch per
+ * sample, so each combination of stages gets its own loop (see
+ * audio_dsp_run) and the whole chain is applied in one pass. */
+
+#define DC_BLOCKER_SHIFT 8     /* pole at 1 - 1/256, ~20 Hz at 32 kHz */
+#define LIMITER_KNEE     24576 /* -2.5 dBFS */
+#define LIMITER_RANGE    (32767 - LIMITER_KNEE)
+
+static bool low_pass_enabled   = false;
+static bool dc_blocker_enabled = false;
+static bool limiter_enabled    = false;
+
+static int32_t low_pass_range  = 0;
+
+/* Filter state, carried from frame to frame */
+static int32_t low_pass_prev[2];
+static int32_t dc_blocker_in[2];
+static int32_t dc_blocker_acc[2]; /* 24.8 fixed point */
+
+void audio_dsp_reset(void)
+{
+   int i;
+
+   for (i = 0; i < 2; i++)
+   {
+      low_pass_prev[i]  = 0;
+      dc_blocker_in[i]  = 0;
+      dc_blocker_acc[i] = 0;
+   }
+}
+
+void audio_dsp_set_low_pass(bool enabled, int32_t range)
+{
+   low_pass_enabled = enabled;
+   low_pass_range   = range;
+}
+
+void audio_dsp_set_dc_blocker(bool enabled)
+{
+   dc_blocker_enabled = enabled;
+}
+
+void audio_dsp_set_limiter(bool enabled)
+{
+   limiter_enabled = enabled;
+}
+
+bool audio_dsp_active(void)
+{
+   return low_pass_enabled || dc_blocker_enabled || limiter_enabled;
+}
+
+static inline int32_t limiter_apply(int32_t v)
+{
+   int32_t d;
+
+   /* Past the knee the curve approaches full scale asymptotically */
+   if (v > LIMITER_KNEE)
+   {
+      d = v - LIMITER_KNEE;
+      return LIMITER_KNEE + (d * LIMITER_RANGE) / (d + LIMITER_RANGE);
+   }
+
+   if (v < -LIMITER_KNEE)
+   {
+      d = -v - LIMITER_KNEE;
+      return -(LIMITER_KNEE + (d * LIMITER_RANGE) / (d + LIMITER_RANGE));
+   }
+
+   return v;
+}
+
+template <bool LOW_PASS, bool DC_BLOCKER, bool LIMITER>
+static void audio_dsp_run(int16_t *buf, int length)
+{
+   int samples = length;
+   int16_t *out = buf;
+
+   /* Restore previous state */
+   int32_t lp_left   = low_pass_prev[0];
+   int32_t lp_right  = low_pass_prev[1];
+   int32_t dc_left   = dc_blocker_in[0];
+   int32_t dc_right  = dc_blocker_in[1];
+   int32_t acc_left  = dc_blocker_acc[0];
+   int32_t acc_right = dc_blocker_acc[1];
+
+   /* Single-pole low-pass filter (6 dB/octave) */
+   int32_t factor_a  = low_pass_range;
+   int32_t factor_b  = 0x10000 - factor_a;
+
+   do
+   {
+      int32_t left  = *out;
+      int32_t right = *(out + 1);
+
+      if (LOW_PASS)
+      {
+         /* 16.16 fixed point, same arithmetic as the original filter */
+         lp_left  = ((lp_left  * factor_a) + (left  * factor_b)) >> 16;
+         lp_right = ((lp_right * factor_a) + (right * factor_b)) >> 16;
+
+         left  = lp_left;
+         right = lp_right;
+      }
+
+      if (DC_BLOCKER)
+      {
+         /* y[n] = x[n] - x[n-1] + (1 - 2^-8) * y[n-1] */
+         acc_left  += ((left  - dc_left)  * (1 << DC_BLOCKER_SHIFT)) - (acc_left  >> DC_BLOCKER_SHIFT);
+         acc_right += ((right - dc_right) * (1 << DC_BLOCKER_SHIFT)) - (acc_right >> DC_BLOCKER_SHIFT);
+
+         dc_left  = left;
+         dc_right = right;
+
+         left  = acc_left  >> DC_BLOCKER_SHIFT;
+         right = acc_right >> DC_BLOCKER_SHIFT;
+      }
+
+      if (LIMITER)
+      {
+         left  = limiter_apply(left);
+         right = limiter_apply(right);
+      }
+      else if (DC_BLOCKER)
+      {
+         /* The high-pass can overshoot a full scale step */
+         if (left  >  32767) left  =  32767;
+         if (left  < -32768) left  = -32768;
+         if (right >  32767) right =  32767;
+         if (right < -32768) right = -32768;
+      }
+
+      *out++ = (int16_t)left;
+      *out++ = (int16_t)right;
+   }
+   while (--samples);
+
+   /* Save state for next frame */
+   low_pass_prev[0]  = lp_left;
+   low_pass_prev[1]  = lp_right;
+   dc_blocker_in[0]  = dc_left;
+   dc_blocker_in[1]  = dc_right;
+   dc_blocker_acc[0] = acc_left;
+   dc_blocker_acc[1] = acc_right;
+}
+
+void audio_dsp_process(int16_t *buf, int length)
+{
+   if (length <= 0)
+      return;
+
+   switch ((low_pass_enabled ? 4 : 0) | (dc_blocker_enabled ? 2 : 0) | (limiter_enabled ? 1 : 0))
+   {
+      case 1: audio_dsp_run<false, false, true >(buf, length); break;
+      case 2: audio_dsp_run<false, true,  false>(buf, length); break;
+      case 3: audio_dsp_run<false, true,  true >(buf, length); break;
+      case 4: audio_dsp_run<true,  false, false>(buf, length); break;
+      case 5: audio_dsp_run<true,  false, true >(buf, length); break;
+      case 6: audio_dsp_run<true,  true,  false>(buf, length); break;
+      case 7: audio_dsp_run<true,  true,  true >(buf, length); break;
+      default: break;
+   }
+}
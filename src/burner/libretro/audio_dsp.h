@@ -0,0 +1,26 @@
+#ifndef AUDIO_DSP_H__
+#define AUDIO_DSP_H__
+
+#include <stdint.h>
+
+/* Post-processing chain applied to the interleaved stereo output of
+ * each frame. Enabled stages run in this order, in place, in a single
+ * pass over the buffer:
+ *
+ *   low-pass    single-pole IIR (6 dB/octave), range in 16.16
+ *   DC blocker  one-pole high-pass at roughly 20 Hz (32 kHz output)
+ *   limiter     soft knee above -2.5 dBFS instead of hard clipping
+ *
+ * With only the low-pass enabled the output is bit-identical to the
+ * original low_pass_filter_stereo(). */
+
+void audio_dsp_reset(void);
+
+void audio_dsp_set_low_pass(bool enabled, int32_t range);
+void audio_dsp_set_dc_blocker(bool enabled);
+void audio_dsp_set_limiter(bool enabled);
+
+bool audio_dsp_active(void);
+void audio_dsp_process(int16_t *buf, int length);
+
+#endif
@@ -43,6 +43,7 @@ static UINT32 memsize[MAX_MEM_PTR];
 // this should be called early on... BurnDrvInit?
 
 static unsigned int total_size = 0;
+static unsigned int peak_size = 0;
 
 char debug_str[256];
 
@@ -51,6 +52,7 @@ void BurnInitMemoryManager(void)
    memset (memptr, 0, MAX_MEM_PTR * sizeof(UINT8 **));
    memset (memsize, 0, MAX_MEM_PTR * sizeof(UINT32 *));
    total_size = 0;
+   peak_size = 0;
 }
 
 // should we pass the pointer as a variable here so that we can save a pointer to it
@@ -80,7 +82,7 @@ UINT32 ctr_get_mappable_range(UINT32 pages)
 }
 
 // call instead of 'malloc'
-UINT8 *BurnMalloc(INT32 size)
+UINT8 *BurnMalloc(size_t size)
 {
    DEBUG_VAR(size);
 
@@ -109,15 +111,17 @@ UINT8 *BurnMalloc(INT32 size)
                if(svcControlMemory((u32*)&memptr[i], addr, 0, size, MEMOP_ALLOC, (MemPerm)(MEMPERM_READ | MEMPERM_WRITE)) < 0)
                {
                   memptr[i] = NULL;
-                  printf("size       : 0x%08X\n", size);
+                  printf("size       : 0x%08X\n", (UINT32)size);
                   printf("total_size : 0x%08X\n", total_size);
-                  printf("BurnMalloc failed to allocate %d bytes of memory!\n", size);
+                  printf("BurnMalloc failed to allocate %d bytes of memory!\n", (INT32)size);
                   DEBUG_HOLD();
                   exit(0);
                }
             }
             memsize[i] = size;
             total_size += size;
+            if (total_size > peak_size)
+               peak_size = total_size;
          }
 
          memset (memptr[i], 0, size); // set contents to 0
@@ -172,3 +176,9 @@ void BurnExitMemoryManager(void)
    total_size = 0;
 }
 
+/* Only the blocks mapped with svcControlMemory() are counted */
+void BurnGetMemoryUsage(UINT64 *pnCurrent, UINT64 *pnPeak)
+{
+   if (pnCurrent) *pnCurrent = total_size;
+   if (pnPeak) *pnPeak = peak_size;
+}
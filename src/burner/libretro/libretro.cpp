@@ -1,10 +1,13 @@
 #include "libretro.h"
 #include "burner.h"
+#include "zlib.h"
 
 #include <stdio.h>
 #include <vector>
 #include <string>
 
+#include "audio_dsp.h"
+
 #ifdef WANT_NEOGEOCD
 #include "cd/cd_interface.h"
 #endif
@@ -22,6 +25,16 @@ char slash = '\\';
 char slash = '/';
 #endif
 
+#if !defined(WII_VM)
+#if defined(_WIN32)
+#include <direct.h>
+#define rom_cache_mkdir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define rom_cache_mkdir(path) mkdir(path, 0755)
+#endif
+#endif
+
 static void log_dummy(enum retro_log_level level, const char *fmt, ...) { }
 
 static void set_controller_infos();
@@ -42,6 +55,12 @@ static retro_audio_sample_batch_t audio_batch_cb;
 // FBARL ---
 
 extern UINT8 NeoSystem;
+extern bool bNeoBooted;
+extern void uPD4990ASetTime();
+#if !defined(WII_VM)
+extern char szNeoROMCachePath[1024];
+extern bool bNeoROMCacheShared;
+#endif
 bool is_neogeo_game = false;
 bool allow_neogeo_mode = true;
 UINT16 switch_ncode = 0;
@@ -99,6 +118,7 @@ struct ROMFIND
 	unsigned int nState;
 	int nArchive;
 	int nPos;
+	unsigned int nCrc; // CRC of the file found in the archive
    BurnRomInfo ri;
 };
 
@@ -115,6 +135,9 @@ static unsigned fba_devices[5] = { RETROPAD_CLASSIC, RETROPAD_CLASSIC, RETROPAD_
 #define AUDIO_SEGMENT_LENGTH 184 // <-- Hardcoded value that corresponds well to 32kHz audio.
 #endif
 
+// Dynamic rate control may stretch a frame's output by up to 0.5%, leave room for it
+#define AUDIO_SEGMENT_LENGTH_MAX (AUDIO_SEGMENT_LENGTH + (AUDIO_SEGMENT_LENGTH / 200) + 1)
+
 static uint16_t *g_fba_frame;
 static int16_t g_audio_buf[AUDIO_SEGMENT_LENGTH * 2];
 
@@ -238,6 +261,30 @@ static const struct retro_core_option_definition option_fba_lowpass_range = {
    "60"
 };
 
+static const struct retro_core_option_definition option_fba_dc_blocker = {
+   CORE_OPTION_NAME "_dc_blocker",
+   "Audio DC Blocker",
+   "Removes any DC offset from the audio output with a high pass filter at around 20 Hz. Avoids clicks when pausing and gives more headroom to games whose mix sits off centre.",
+   {
+      { "disabled", NULL },
+      { "enabled",  NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_soft_limiter = {
+   CORE_OPTION_NAME "_soft_limiter",
+   "Audio Soft Limiter",
+   "Gently compresses peaks above -2.5 dBFS instead of letting them clip. Useful with loud games or when combined with the audio filters.",
+   {
+      { "disabled", NULL },
+      { "enabled",  NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
 static const struct retro_core_option_definition option_fba_frameskip = {
    CORE_OPTION_NAME "_frameskip",
    "Frameskip",
@@ -277,6 +324,71 @@ static const struct retro_core_option_definition option_fba_frameskip_threshold
    "33"
 };
 
+static const struct retro_core_option_definition option_fba_audio_rate_control = {
+   CORE_OPTION_NAME "_audio_rate_control",
+   "Dynamic Audio Rate Control",
+   "Stretch the audio output of each frame by up to 0.5% to keep the frontend audio buffer half full. Reduces crackling without dropping frames; frameskip is then only used as a last resort. The emulation itself is unaffected. Requires frontend support for audio buffer status monitoring.",
+   {
+      { "disabled", NULL },
+      { "enabled", NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_rewind = {
+   CORE_OPTION_NAME "_rewind",
+   "Native Rewind",
+   "Keeps the last frames in a buffer of the selected size, and rewinds the game while R3 is held. Each frame is stored as the compressed difference from the next one, so even a small buffer covers several minutes. Much cheaper than the frontend's rewind, which should be left disabled.",
+   {
+      { "disabled", NULL },
+      { "16",  "16 MB" },
+      { "32",  "32 MB" },
+      { "64",  "64 MB" },
+      { "128", "128 MB" },
+      { "256", "256 MB" },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_movie = {
+   CORE_OPTION_NAME "_movie",
+   "Input Movie",
+   "'record' records the inputs of the whole session, from power-on, into a movie in the save directory (named after the game, with the extension .fbm). 'play' plays that movie back instead of reading the controllers, repeating the session exactly. Applied on next game load. Run-ahead, rewind and loading a state stop the movie, since it can't follow the game back to an earlier frame.",
+   {
+      { "disabled", NULL },
+      { "record",   NULL },
+      { "play",     NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_nvram_write_behind = {
+   CORE_OPTION_NAME "_nvram_write_behind",
+   "NVRAM Write-Behind",
+   "Saves the NVRAM (high scores, bookkeeping, settings) in the background about a second after the game changes it, instead of only when the game is closed, so it survives crashes and power cuts. The .fs file is then the only copy: the NVRAM isn't handed to the frontend as save RAM (.srm), whose older copy would otherwise be loaded over it. Applied on next game load.",
+   {
+      { "disabled", NULL },
+      { "enabled",  NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_state_codec = {
+   CORE_OPTION_NAME "_state_codec",
+   "State File Compression",
+   "How the state files the core writes itself (the NVRAM on exit and with write-behind, the Neo Geo boot cache) are compressed. 'fast' takes a fraction of the time of 'deflate' for somewhat larger files, which older versions of the core can't read. Save states and run-ahead go through the frontend, which gets them uncompressed and compresses them itself.",
+   {
+      { "deflate", NULL },
+      { "fast",    NULL },
+      { NULL, NULL },
+   },
+   "deflate"
+};
+
 /* > Neo Geo core options */
 
 static const struct retro_core_option_definition option_fba_neogeo_mode = {
@@ -293,6 +405,35 @@ static const struct retro_core_option_definition option_fba_neogeo_mode = {
    "MVS"
 };
 
+#if !defined(WII_VM)
+static const struct retro_core_option_definition option_fba_neogeo_rom_cache = {
+   CORE_OPTION_NAME "_neogeo_rom_cache",
+   "Neo Geo ROM Cache",
+   "Keep a copy of the decrypted and decoded cartridge ROMs in the 'cache' folder of the system directory. The first start builds it, later starts load it directly and are much faster for large encrypted games. On Linux and macOS the sprites and sound samples are then mapped from the cache and only read into memory as the game uses them, with samples read ahead as they start to play; without the cache the whole game is held in memory. Takes as much disk space as the game's ROMs uncompressed. 'shared' keeps it in shared memory instead, where every running instance of the same game uses a single copy (Linux and macOS). Applied on next game load.",
+   {
+      { "disabled", NULL },
+      { "enabled",  NULL },
+#if defined(HAVE_SHM)
+      { "shared",   NULL },
+#endif
+      { NULL, NULL },
+   },
+   "disabled"
+};
+
+static const struct retro_core_option_definition option_fba_neogeo_boot_cache = {
+   CORE_OPTION_NAME "_neogeo_boot_cache",
+   "Neo Geo Boot Cache",
+   "Skip the BIOS start-up (self-test and logo). The first start of a game saves the machine as the BIOS hands over to the cartridge into the 'cache' folder of the system directory, later starts with the same BIOS, DIP switches and NVRAM go on from there, with the clock set to the current time. Reset still runs the whole BIOS. Applied on next game load.",
+   {
+      { "disabled", NULL },
+      { "enabled",  NULL },
+      { NULL, NULL },
+   },
+   "disabled"
+};
+#endif
+
 void retro_set_environment(retro_environment_t cb)
 {
    environ_cb = cb;
@@ -322,9 +463,44 @@ static void retro_audio_buff_status_cb(
    retro_audio_buff_underrun  = underrun_likely;
 }
 
+/* Native rewind, see BurnRewindInit(). The buffer is
+ * (re)allocated by retro_run() when the size changes */
+static unsigned rewind_size                = 0;
+static unsigned rewind_size_active         = 0;
+
+/* Battery backed memory, see sram_init() and sram_write_behind() */
+static void *sram_data                     = NULL;
+static size_t sram_size                    = 0;
+static bool sram_write_behind_enabled      = false;
+static UINT32 sram_changes_saved           = 0;
+static UINT32 sram_changes_seen            = 0;
+static unsigned sram_quiet_frames          = 0;
+static unsigned sram_dirty_frames          = 0;
+static bool sram_write_behind_active       = false;
+
+#if !defined(WII_VM)
+/* Neo Geo boot cache, see boot_cache_start() */
+static char boot_cache_fs[1024];
+static char boot_cache_last[1024];
+static bool boot_cache_pending             = false;
+static bool boot_cache_armed               = false;
+
+static void boot_cache_start(void);
+static void boot_cache_save_last(void);
+#endif
+
+/* Background state saves, see state_save_start() */
+static char state_save_pending[1024];
+static bool state_save_boot_cache          = false;
+
+static void state_save_collect(void);
+
+/* Dynamic audio rate control, see audio_rate_control_update() */
+static bool audio_rate_control             = false;
+
 static void init_frameskip(void)
 {
-   if (frameskip_type > 0)
+   if ((frameskip_type > 0) || audio_rate_control)
    {
       struct retro_audio_buffer_status_callback buf_status_cb;
 
@@ -333,7 +509,7 @@ static void init_frameskip(void)
             &buf_status_cb))
       {
          if (log_cb)
-            log_cb(RETRO_LOG_WARN, "Frameskip disabled - frontend does not support audio buffer status monitoring.\n");
+            log_cb(RETRO_LOG_WARN, "Frameskip and audio rate control disabled - frontend does not support audio buffer status monitoring.\n");
 
          retro_audio_buff_active    = false;
          retro_audio_buff_occupancy = 0;
@@ -342,7 +518,7 @@ static void init_frameskip(void)
       }
       else
       {
-         /* Frameskip is enabled - increase frontend
+         /* Frameskip or rate control is enabled - increase frontend
           * audio latency to minimise potential
           * buffer underruns */
 #ifdef FBACORES_CPS
@@ -366,46 +542,170 @@ static void init_frameskip(void)
    update_audio_latency = true;
 }
 
-/* Low pass audio filter */
+/* Audio ring buffer
+ *
+ * Ring of stereo frames between the emulated frame and
+ * audio_batch_cb(), both of which run on the frontend's thread.
+ * Frontends are allowed to accept fewer frames than offered, whatever
+ * is left over stays in the ring and goes out ahead of the next frame
+ * instead of being dropped. Only one frame's worth is held back that
+ * way: if the frontend takes nothing for a while, the oldest audio
+ * makes room for the newest, so a stall never turns into lag. */
+
+#define AUDIO_RING_FRAMES  4096 /* must be a power of two */
+#define AUDIO_RING_MASK    (AUDIO_RING_FRAMES - 1)
+#define AUDIO_RING_BACKLOG AUDIO_SEGMENT_LENGTH_MAX /* kept from earlier frames at most */
+
+static int16_t audio_ring[AUDIO_RING_FRAMES * 2];
+static unsigned audio_ring_head = 0; /* free running counters */
+static unsigned audio_ring_tail = 0;
+
+static void audio_ring_reset(void)
+{
+   audio_ring_head = 0;
+   audio_ring_tail = 0;
+}
 
-static bool low_pass_enabled       = false;
-static int32_t low_pass_range      = 0;
-/* Previous samples */
-static int32_t low_pass_left_prev  = 0;
-static int32_t low_pass_right_prev = 0;
+static void audio_ring_write(const int16_t *buf, unsigned frames)
+{
+   unsigned head = audio_ring_head;
 
-static void low_pass_filter_stereo(int16_t *buf, int length)
+   /* Age out what the frontend hasn't taken from earlier frames */
+   if (head - audio_ring_tail > AUDIO_RING_BACKLOG)
+      audio_ring_tail = head - AUDIO_RING_BACKLOG;
+
+   if (frames > AUDIO_RING_FRAMES - AUDIO_RING_BACKLOG)
+   {
+      buf    += (frames - (AUDIO_RING_FRAMES - AUDIO_RING_BACKLOG)) << 1;
+      frames  = AUDIO_RING_FRAMES - AUDIO_RING_BACKLOG;
+   }
+
+   while (frames)
+   {
+      unsigned pos   = head & AUDIO_RING_MASK;
+      unsigned chunk = AUDIO_RING_FRAMES - pos;
+
+      if (chunk > frames)
+         chunk = frames;
+
+      memcpy(audio_ring + (pos << 1), buf, (chunk << 1) * sizeof(int16_t));
+
+      buf    += chunk << 1;
+      head   += chunk;
+      frames -= chunk;
+   }
+
+   audio_ring_head = head;
+}
+
+static void audio_ring_flush(void)
 {
-   int samples            = length;
-   int16_t *out           = buf;
+   unsigned tail = audio_ring_tail;
+   unsigned head = audio_ring_head;
+
+   while (head != tail)
+   {
+      unsigned pos     = tail & AUDIO_RING_MASK;
+      unsigned chunk   = AUDIO_RING_FRAMES - pos;
+      unsigned written;
 
-   /* Restore previous samples */
-   int32_t low_pass_left  = low_pass_left_prev;
-   int32_t low_pass_right = low_pass_right_prev;
+      if (chunk > head - tail)
+         chunk = head - tail;
 
-   /* Single-pole low-pass filter (6 dB/octave) */
-   int32_t factor_a       = low_pass_range;
-   int32_t factor_b       = 0x10000 - factor_a;
+      written = audio_batch_cb(audio_ring + (pos << 1), chunk);
+      if (written > chunk)
+         written = chunk;
 
-   do
+      tail += written;
+
+      /* Frontend is full, keep the rest for next time */
+      if (written < chunk)
+         break;
+   }
+
+   audio_ring_tail = tail;
+}
+
+/* Dynamic audio rate control
+ *
+ * Stretches or squeezes each frame of audio by up to +/-0.5% on its
+ * way to the ring, in proportion to how far the frontend audio buffer
+ * is from half full, instead of dropping video frames. The emulation
+ * always makes AUDIO_SEGMENT_LENGTH samples a frame: the sound cores
+ * take nBurnSoundLen as the length of the frame, so changing it would
+ * make the emulation depend on the host and break rollback, movies
+ * and netplay. The fractional part of the output length is carried
+ * over in 16.16 fixed point so the long term average rate is exact. */
+
+#define AUDIO_RATE_CONTROL_TARGET   50   /* % occupancy */
+#define AUDIO_RATE_CONTROL_MAX_PPM  5000 /* 0.5% */
+
+static uint32_t audio_rate_control_frac = 0;
+static unsigned audio_rate_control_len  = AUDIO_SEGMENT_LENGTH;
+static int16_t audio_rate_control_buf[AUDIO_SEGMENT_LENGTH_MAX * 2];
+
+static void audio_rate_control_reset(void)
+{
+   audio_rate_control_frac = 0;
+   audio_rate_control_len  = AUDIO_SEGMENT_LENGTH;
+}
+
+/* Work out how many frames this frame's audio goes out as */
+static void audio_rate_control_update(void)
+{
+   int32_t occupancy;
+   int32_t ppm;
+   uint64_t len;
+
+   if (!audio_rate_control || !retro_audio_buff_active)
    {
-      /* Apply low-pass filter */
-      low_pass_left  = (low_pass_left  * factor_a) + (*out       * factor_b);
-      low_pass_right = (low_pass_right * factor_a) + (*(out + 1) * factor_b);
+      audio_rate_control_reset();
+      return;
+   }
 
-      /* 16.16 fixed point */
-      low_pass_left  >>= 16;
-      low_pass_right >>= 16;
+   occupancy = (int32_t)retro_audio_buff_occupancy;
+   if (occupancy > 100)
+      occupancy = 100;
 
-      /* Update sound buffer */
-      *out++ = (int16_t)low_pass_left;
-      *out++ = (int16_t)low_pass_right;
+   ppm = ((AUDIO_RATE_CONTROL_TARGET - occupancy) * AUDIO_RATE_CONTROL_MAX_PPM) / AUDIO_RATE_CONTROL_TARGET;
+
+   len  = ((uint64_t)AUDIO_SEGMENT_LENGTH << 16) * (uint64_t)(1000000 + ppm) / 1000000;
+   len += audio_rate_control_frac;
+
+   audio_rate_control_len  = (unsigned)(len >> 16);
+   audio_rate_control_frac = (uint32_t)(len & 0xFFFF);
+
+   if (audio_rate_control_len > AUDIO_SEGMENT_LENGTH_MAX)
+      audio_rate_control_len = AUDIO_SEGMENT_LENGTH_MAX;
+}
+
+/* Resample a frame of audio to audio_rate_control_len frames,
+ * interpolating linearly, and queue it */
+static void audio_rate_control_write(const int16_t *buf, unsigned frames)
+{
+   uint32_t step;
+   uint32_t pos = 0;
+   unsigned i;
+
+   if (audio_rate_control_len == frames)
+   {
+      audio_ring_write(buf, frames);
+      return;
+   }
+
+   step = (frames << 16) / audio_rate_control_len;
+
+   for (i = 0; i < audio_rate_control_len; i++, pos += step)
+   {
+      unsigned j    = pos >> 16;
+      unsigned k    = (j + 1 < frames) ? j + 1 : j;
+      int32_t  frac = (pos & 0xFFFF) >> 1;
+
+      audio_rate_control_buf[i * 2 + 0] = buf[j * 2 + 0] + (((buf[k * 2 + 0] - buf[j * 2 + 0]) * frac) >> 15);
+      audio_rate_control_buf[i * 2 + 1] = buf[j * 2 + 1] + (((buf[k * 2 + 1] - buf[j * 2 + 1]) * frac) >> 15);
    }
-   while (--samples);
 
-   /* Save last samples for next frame */
-   low_pass_left_prev  = low_pass_left;
-   low_pass_right_prev = low_pass_right;
+   audio_ring_write(audio_rate_control_buf, audio_rate_control_len);
 }
 
 struct RomBiosInfo {
@@ -736,7 +1036,7 @@ static int InpDIPSWInit(void)
 
             BurnDrvGetDIPInfo(&(dip_value->bdi), k + i + 1);
             dip_value->pgi = pgi_value;
-            strncpy(dip_value->friendly_name, dip_value->bdi.szText, sizeof(dip_value->friendly_name));
+            snprintf(dip_value->friendly_name, sizeof(dip_value->friendly_name), "%s", dip_value->bdi.szText);
 
             bool is_default_value = (dip_value->pgi->Input.Constant.nConst & dip_value->bdi.nMask) == (dip_value->bdi.nSetting);
 
@@ -865,8 +1165,15 @@ static void set_environment()
    options_system.push_back(&option_fba_cpu_speed_adjust);
    options_system.push_back(&option_fba_lowpass_filter);
    options_system.push_back(&option_fba_lowpass_range);
+   options_system.push_back(&option_fba_dc_blocker);
+   options_system.push_back(&option_fba_soft_limiter);
    options_system.push_back(&option_fba_frameskip);
    options_system.push_back(&option_fba_frameskip_threshold);
+   options_system.push_back(&option_fba_audio_rate_control);
+   options_system.push_back(&option_fba_rewind);
+   options_system.push_back(&option_fba_movie);
+   options_system.push_back(&option_fba_nvram_write_behind);
+   options_system.push_back(&option_fba_state_codec);
 
    if (pgi_diag)
    {
@@ -878,6 +1185,10 @@ static void set_environment()
       // Add the Neo Geo core options
       if (allow_neogeo_mode)
          options_system.push_back(&option_fba_neogeo_mode);
+#if !defined(WII_VM)
+      options_system.push_back(&option_fba_neogeo_rom_cache);
+      options_system.push_back(&option_fba_neogeo_boot_cache);
+#endif
    }
 
    int nbr_options = options_system.size();
@@ -1118,6 +1429,9 @@ static void ForceFrameStep(void)
    nBurnSoundRate = AUDIO_SAMPLERATE;
    nCurrentFrame++;
 
+   if (BurnMovieFrame())
+      log_cb(RETRO_LOG_INFO, "[FBA] Input movie stopped.\n");
+
    BurnDrvFrame();
 }
 
@@ -1179,6 +1493,125 @@ static void free_archive_list(ZipEntry *list, unsigned count)
    }
 }
 
+/* While a game loads, the archive holding the last requested ROM stays
+ * open, so going from one ROM to the next doesn't reread the archive's
+ * central directory. With more than one CPU, a request for a ROM also
+ * inflates the ROMs that follow it in the same archive in parallel
+ * (ZipLoadFiles), one per CPU and up to ARCHIVE_PREFETCH_MAX bytes. They
+ * are then handed out from memory as the driver asks for them. This
+ * trades memory for speed: unlike a ROM streamed block by block, a
+ * prefetched ROM is held whole until the driver takes it, so the limit
+ * is kept small to bound the extra peak. BIOS and optional ROMs are only
+ * loaded on request, and so are ROMs stored uncompressed: there is
+ * nothing to inflate, and the driver may map them instead (see
+ * archive_find_stored_rom). */
+#define ARCHIVE_PREFETCH_MAX (16 << 20)
+
+static int g_open_archive = -1;
+static uint8_t *g_prefetch_data[1024];
+static int g_prefetch_len[1024];
+
+static bool archive_open(int archive)
+{
+   if (g_open_archive == archive)
+      return true;
+
+   if (g_open_archive >= 0)
+      ZipClose();
+   g_open_archive = -1;
+
+   if (ZipOpen((char*)g_find_list_path[archive].c_str()) != 0)
+      return false;
+
+   g_open_archive = archive;
+   return true;
+}
+
+static void archive_close()
+{
+   if (g_open_archive >= 0)
+      ZipClose();
+   g_open_archive = -1;
+
+   for (unsigned i = 0; i < sizeof(g_prefetch_data) / sizeof(g_prefetch_data[0]); i++)
+   {
+      if (g_prefetch_data[i])
+         free(g_prefetch_data[i]);
+      g_prefetch_data[i] = NULL;
+   }
+}
+
+static bool archive_prefetchable(int i, int archive)
+{
+   if (g_find_list[i].nState != STAT_OK || g_find_list[i].nArchive != archive || g_prefetch_data[i])
+      return false;
+
+   if (g_find_list[i].ri.nLen == 0 || (g_find_list[i].ri.nType & (BRF_BIOS | BRF_OPT | BRF_NODUMP)))
+      return false;
+
+   if (ZipGetStoredEntry(g_find_list[i].nPos, NULL, NULL) == 0)
+      return false;
+
+   return true;
+}
+
+static void archive_prefetch(int i)
+{
+   struct ZipLoadRequest requests[64];
+   int rom[64];
+   int count = 0;
+   unsigned total = 0;
+   int archive = g_find_list[i].nArchive;
+   int threads = BurnThreadCount();
+
+   if (threads < 2 || g_find_list[i].nState != STAT_OK)
+      return;
+
+   /* More ROMs than CPUs would only be held in memory longer */
+   if (threads > (int)(sizeof(requests) / sizeof(requests[0])))
+      threads = sizeof(requests) / sizeof(requests[0]);
+
+   for (int j = i; j < (int)g_rom_count && count < threads; j++)
+   {
+      if (j != i && !archive_prefetchable(j, archive))
+         continue;
+      if (j != i && total + g_find_list[j].ri.nLen > ARCHIVE_PREFETCH_MAX)
+         break;
+
+      requests[count].Dest   = (UINT8*)malloc(g_find_list[j].ri.nLen);
+      requests[count].nLen   = g_find_list[j].ri.nLen;
+      requests[count].nEntry = g_find_list[j].nPos;
+      if (!requests[count].Dest)
+         break;
+
+      rom[count] = j;
+      total += g_find_list[j].ri.nLen;
+      count++;
+   }
+
+   if (count < 2)
+   {
+      /* Nothing to overlap with, load it the usual way */
+      for (int k = 0; k < count; k++)
+         free(requests[k].Dest);
+      return;
+   }
+
+   ZipLoadFiles(requests, count);
+
+   /* Failed ROMs are dropped here and fail again through the normal path */
+   for (int k = 0; k < count; k++)
+   {
+      if (requests[k].nRet == 0)
+      {
+         g_prefetch_data[rom[k]] = requests[k].Dest;
+         g_prefetch_len[rom[k]]  = requests[k].nWrote;
+      }
+      else
+         free(requests[k].Dest);
+   }
+}
+
 static int archive_load_rom(uint8_t *dest, int *wrote, int i)
 {
    if (i < 0 || i >= g_rom_count)
@@ -1186,19 +1619,95 @@ static int archive_load_rom(uint8_t *dest, int *wrote, int i)
 
    int archive = g_find_list[i].nArchive;
 
-   if (ZipOpen((char*)g_find_list_path[archive].c_str()) != 0)
+   if (!archive_open(archive))
       return 1;
 
+   if (!g_prefetch_data[i])
+      archive_prefetch(i);
+
+   if (g_prefetch_data[i])
+   {
+      memcpy(dest, g_prefetch_data[i], g_prefetch_len[i]);
+      if (wrote)
+         *wrote = g_prefetch_len[i];
+
+      free(g_prefetch_data[i]);
+      g_prefetch_data[i] = NULL;
+      return 0;
+   }
+
    BurnRomInfo ri = {0};
    BurnDrvGetRomInfo(&ri, i);
 
    if (ZipLoadFile(dest, ri.nLen, wrote, g_find_list[i].nPos) != 0)
-   {
-      ZipClose();
       return 1;
+
+   return 0;
+}
+
+static int archive_load_rom_chunked(int i, int *wrote, BurnLoadRomChunk chunk, void *param)
+{
+   if (i < 0 || i >= g_rom_count)
+      return 1;
+
+   int archive = g_find_list[i].nArchive;
+
+   if (!archive_open(archive))
+      return 1;
+
+   if (!g_prefetch_data[i])
+      archive_prefetch(i);
+
+   if (g_prefetch_data[i])
+   {
+      int ret = chunk(g_prefetch_data[i], 0, g_prefetch_len[i], param);
+      if (wrote)
+         *wrote = g_prefetch_len[i];
+
+      free(g_prefetch_data[i]);
+      g_prefetch_data[i] = NULL;
+      return ret ? 1 : 0;
    }
 
-   ZipClose();
+   BurnRomInfo ri = {0};
+   BurnDrvGetRomInfo(&ri, i);
+
+   if (ZipLoadFileChunked(ri.nLen, wrote, g_find_list[i].nPos, chunk, param) != 0)
+      return 1;
+
+   return 0;
+}
+
+static int archive_find_stored_rom(int i, char *file, int file_len, INT64 *offset)
+{
+   char *zip_name = NULL;
+
+   if (i < 0 || i >= g_rom_count || g_find_list[i].nState != STAT_OK)
+      return 1;
+
+   /* Already read into memory, mapping it wouldn't save anything */
+   if (g_prefetch_data[i])
+      return 1;
+
+   if (!archive_open(g_find_list[i].nArchive))
+      return 1;
+
+   if (ZipGetStoredEntry(g_find_list[i].nPos, &zip_name, offset) != 0)
+      return 1;
+
+   if ((int)strlen(zip_name) >= file_len)
+      return 1;
+
+   strcpy(file, zip_name);
+   return 0;
+}
+
+static int archive_get_rom_crc(int i, UINT32 *crc)
+{
+   if (i < 0 || i >= g_rom_count || g_find_list[i].nState != STAT_OK)
+      return 1;
+
+   *crc = g_find_list[i].nCrc;
    return 0;
 }
 
@@ -1216,6 +1725,7 @@ int get_cache_path(char *path)
 // This code is very confusing. The original code is even more confusing :(
 static bool open_archive()
 {
+	archive_close();
 	memset(g_find_list, 0, sizeof(g_find_list));
 
 	// FBA wants some roms ... Figure out how many.
@@ -1252,13 +1762,14 @@ static bool open_archive()
 		log_cb(RETRO_LOG_INFO, "[FBA] Archive: %s\n", rom_name);
 
 		char path[1024];
+		int path_len;
 #if defined(_XBOX) || defined(_WIN32)
-		snprintf(path, sizeof(path), "%s\\%s", g_rom_dir, rom_name);
+		path_len = snprintf(path, sizeof(path), "%s\\%s", g_rom_dir, rom_name);
 #else
-		snprintf(path, sizeof(path), "%s/%s", g_rom_dir, rom_name);
+		path_len = snprintf(path, sizeof(path), "%s/%s", g_rom_dir, rom_name);
 #endif
 
-		if (ZipOpen(path) != 0)
+		if (path_len >= (int)sizeof(path) || ZipOpen(path) != 0)
 			log_cb(RETRO_LOG_ERROR, "[FBA] Failed to find archive: %s, let's continue with other archives...\n", path);
 		else
 			g_find_list_path.push_back(path);
@@ -1288,6 +1799,7 @@ static bool open_archive()
 
 			if (g_find_list[i].ri.nType == 0 || g_find_list[i].ri.nLen == 0 || g_find_list[i].ri.nCrc == 0)
 			{
+				g_find_list[i].nCrc = g_find_list[i].ri.nCrc;
 				g_find_list[i].nState = STAT_OK;
 				continue;
 			}
@@ -1347,6 +1859,7 @@ static bool open_archive()
 			// Yay, we found it!
 			g_find_list[i].nArchive = z;
 			g_find_list[i].nPos = index;
+			g_find_list[i].nCrc = list[index].nCrc;
 			g_find_list[i].nState = STAT_OK;
 
 			if (list[index].nLen < g_find_list[i].ri.nLen)
@@ -1396,6 +1909,9 @@ static bool open_archive()
 	}
 
 	BurnExtLoadRom = archive_load_rom;
+	BurnExtLoadRomChunked = archive_load_rom_chunked;
+	BurnExtFindStoredRom = archive_find_stored_rom;
+	BurnExtGetRomCrc = archive_get_rom_crc;
 	return true;
 }
 
@@ -1418,10 +1934,26 @@ void retro_init()
    audio_latency              = 0;
    update_audio_latency       = false;
 
-   low_pass_enabled           = false;
-   low_pass_range             = 0;
-   low_pass_left_prev         = 0;
-   low_pass_right_prev        = 0;
+   audio_dsp_set_low_pass(false, 0);
+   audio_dsp_set_dc_blocker(false);
+   audio_dsp_set_limiter(false);
+   audio_dsp_reset();
+
+   audio_rate_control         = false;
+   audio_rate_control_frac    = 0;
+   audio_rate_control_len     = AUDIO_SEGMENT_LENGTH;
+   audio_ring_reset();
+
+   rewind_size                = 0;
+   rewind_size_active         = 0;
+
+   sram_write_behind_enabled  = false;
+   sram_write_behind_active   = false;
+   nBurnStateCodec            = BURN_STATE_DEFLATE;
+#if !defined(WII_VM)
+   boot_cache_pending         = false;
+   boot_cache_armed           = false;
+#endif
 }
 
 void retro_deinit()
@@ -1430,11 +1962,19 @@ void retro_deinit()
    {
       char output_fs[1024];
 
-      snprintf(output_fs, sizeof(output_fs), "%s%c%s.fs", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME));
-      BurnStateSave(output_fs, 0);
+      state_save_collect();
+      if (snprintf(output_fs, sizeof(output_fs), "%s%c%s.fs", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME)) >= (int)sizeof(output_fs)
+            || BurnStateSave(output_fs, 0))
+         log_cb(RETRO_LOG_WARN, "[FBA] Cannot save %s\n", output_fs);
+      BurnMovieStop();
+      BurnRewindExit();
       BurnDrvExit();
    }
+   rewind_size_active = 0;
+   sram_data = NULL;
+   sram_size = 0;
    driver_inited = false;
+   archive_close();
    BurnLibExit();
    if (g_fba_frame)
       free(g_fba_frame);
@@ -1456,14 +1996,16 @@ void retro_reset()
 
    ForceFrameStep();
 
-   low_pass_left_prev  = 0;
-   low_pass_right_prev = 0;
+   audio_dsp_reset();
 }
 
 static void check_variables(bool first_run)
 {
    struct retro_variable var = {0};
    unsigned last_frameskip_type;
+   bool last_audio_rate_control;
+   bool low_pass_enabled;
+   int32_t low_pass_range;
 
    var.key = option_fba_cpu_speed_adjust.key;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
@@ -1595,6 +2137,24 @@ static void check_variables(bool first_run)
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
       low_pass_range = (strtol(var.value, NULL, 10) * 65536) / 100;
 
+   audio_dsp_set_low_pass(low_pass_enabled, low_pass_range);
+
+   var.key             = option_fba_dc_blocker.key;
+   var.value           = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      audio_dsp_set_dc_blocker(strcmp(var.value, "enabled") == 0);
+   else
+      audio_dsp_set_dc_blocker(false);
+
+   var.key             = option_fba_soft_limiter.key;
+   var.value           = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      audio_dsp_set_limiter(strcmp(var.value, "enabled") == 0);
+   else
+      audio_dsp_set_limiter(false);
+
    var.key             = option_fba_frameskip.key;
    var.value           = NULL;
    last_frameskip_type = frameskip_type;
@@ -1615,8 +2175,41 @@ static void check_variables(bool first_run)
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
       frameskip_threshold = strtol(var.value, NULL, 10);
 
+   var.key                 = option_fba_audio_rate_control.key;
+   var.value               = NULL;
+   last_audio_rate_control = audio_rate_control;
+   audio_rate_control      = false;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      if (strcmp(var.value, "enabled") == 0)
+         audio_rate_control = true;
+
+   var.key                   = option_fba_nvram_write_behind.key;
+   var.value                 = NULL;
+   sram_write_behind_enabled = false;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      if (strcmp(var.value, "enabled") == 0)
+         sram_write_behind_enabled = true;
+
+   var.key         = option_fba_state_codec.key;
+   var.value       = NULL;
+   nBurnStateCodec = BURN_STATE_DEFLATE;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      if (strcmp(var.value, "fast") == 0)
+         nBurnStateCodec = BURN_STATE_FAST;
+
+   var.key     = option_fba_rewind.key;
+   var.value   = NULL;
+   rewind_size = 0;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      rewind_size = strtol(var.value, NULL, 10);
+
    /* (Re)Initialise frameskipping, if required */
-   if ((frameskip_type != last_frameskip_type) || first_run)
+   if ((frameskip_type != last_frameskip_type) ||
+       (audio_rate_control != last_audio_rate_control) || first_run)
       init_frameskip();
 }
 
@@ -1943,13 +2536,128 @@ static void InputMake(void)
 }
 
 
+static int burn_sram_area_cb(BurnArea *pba)
+{
+   if (!sram_data)
+   {
+      sram_data = pba->Data;
+      sram_size = pba->nLen;
+   }
+   return 0;
+}
+
+/* Expose the first battery backed area (the NVRAM on MVS,
+ * the built-in memory card on Neo Geo CD) as the save RAM,
+ * unless write-behind keeps it in the .fs file instead */
+static void sram_init(void)
+{
+   sram_data = NULL;
+   sram_size = 0;
+
+   sram_write_behind_active = sram_write_behind_enabled;
+   if (!sram_write_behind_active)
+   {
+      BurnAcb = burn_sram_area_cb;
+      BurnAreaScan(ACB_NVRAM, NULL);
+   }
+
+   sram_changes_saved = nBurnNVRAMChanges;
+   sram_changes_seen  = nBurnNVRAMChanges;
+   sram_quiet_frames  = 0;
+   sram_dirty_frames  = 0;
+}
+
+/* Collect the background save started by state_save_start()
+ * and report how it went. Only blocks if it is still being
+ * written, retro_run() calls this once BurnStateSaveDone() */
+static void state_save_collect(void)
+{
+   if (!state_save_pending[0])
+      return;
+
+   if (BurnStateSaveWait())
+      log_cb(RETRO_LOG_WARN, "[FBA] Cannot save %s\n", state_save_pending);
+#if !defined(WII_VM)
+   else if (state_save_boot_cache)
+   {
+      boot_cache_save_last();
+      log_cb(RETRO_LOG_INFO, "[FBA] Saved boot cache %s\n", state_save_pending);
+   }
+#endif
+
+   state_save_pending[0]  = '\0';
+   state_save_boot_cache  = false;
+}
+
+/* Save a state on another thread, see BurnStateSaveBackground().
+ * The outcome is only known, and logged, once it is collected */
+static void state_save_start(const char *name, int all, bool boot_cache)
+{
+   state_save_collect();
+
+   if (BurnStateSaveBackground((TCHAR*)name, all))
+   {
+      log_cb(RETRO_LOG_WARN, "[FBA] Cannot save %s\n", name);
+      return;
+   }
+
+   strncpy(state_save_pending, name, sizeof(state_save_pending) - 1);
+   state_save_pending[sizeof(state_save_pending) - 1] = '\0';
+   state_save_boot_cache = boot_cache;
+}
+
+/* Once the game has left the NVRAM alone for a second after
+ * changing it, save it the way retro_deinit() does. A game
+ * that never stops changing it is saved every ten seconds.
+ * Only the copy is made here, the file is written on
+ * another thread */
+static void sram_write_behind(void)
+{
+   char output_fs[1024];
+
+   if (nBurnNVRAMChanges == sram_changes_saved)
+      return;
+
+   sram_dirty_frames++;
+   if (nBurnNVRAMChanges != sram_changes_seen)
+   {
+      sram_changes_seen = nBurnNVRAMChanges;
+      sram_quiet_frames = 0;
+   }
+   else
+      sram_quiet_frames++;
+
+   if (sram_quiet_frames < 60 && sram_dirty_frames < 600)
+      return;
+
+   sram_changes_saved = nBurnNVRAMChanges;
+   sram_quiet_frames  = 0;
+   sram_dirty_frames  = 0;
+
+   if (snprintf(output_fs, sizeof(output_fs), "%s%c%s.fs", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME)) >= (int)sizeof(output_fs))
+      return;
+
+   state_save_start(output_fs, 0, false);
+}
+
 void retro_run(void)
 {
+   bool hidden_frame = false;
+   bool rewinding = false;
    int width, height;
    BurnDrvGetVisibleSize(&width, &height);
    pBurnDraw = (uint8_t*)g_fba_frame;
    nBurnPitch = width * sizeof(uint16_t);
    nSkipFrame = 0;
+   bBurnNoRender = false;
+
+#if !defined(WII_VM)
+   if (boot_cache_pending)
+   {
+      boot_cache_pending = false;
+      boot_cache_start();
+   }
+#endif
 
    InputMake();
 
@@ -1988,17 +2696,84 @@ void retro_run(void)
       update_audio_latency = false;
    }
 
+   /* Frames the frontend throws away (e.g. the hidden
+    * ones of run-ahead) need neither video nor sound */
+   {
+      int av_enable = 3;
+
+      if (!environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable))
+         av_enable = 3;
+
+      if (!(av_enable & 1))
+      {
+         /* Run-ahead takes the frame back later on, which
+          * a movie can't follow, so it mustn't see it */
+         if (BurnMovieStatus() != MOVIE_NONE)
+         {
+            BurnMovieStop();
+            log_cb(RETRO_LOG_WARN, "[FBA] Input movie stopped by run-ahead.\n");
+         }
+
+         hidden_frame = true;
+         nSkipFrame = 1;
+         if (!(av_enable & 2))
+            bBurnNoRender = true;
+      }
+   }
+
+   /* Go back a frame while the rewind button is held. The
+    * frame is then run as usual to show it, but not recorded */
+   if (rewind_size != rewind_size_active)
+   {
+      rewind_size_active = rewind_size;
+      if (rewind_size_active && BurnRewindInit(rewind_size_active << 20))
+      {
+         log_cb(RETRO_LOG_WARN, "[FBA] Native rewind disabled - cannot allocate %u MB.\n", rewind_size_active);
+         rewind_size = rewind_size_active = 0;
+      }
+      else if (!rewind_size_active)
+         BurnRewindExit();
+   }
+
+   if (rewind_size_active && !hidden_frame && BurnMovieStatus() == MOVIE_NONE && input_cb(0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_R3))
+      rewinding = (BurnRewindStep() == 0);
+
    ForceFrameStep();
 
+   if (rewind_size_active && !hidden_frame && !rewinding)
+      BurnRewindPush();
+
+   if (sram_write_behind_active && !hidden_frame)
+      sram_write_behind();
+
+#if !defined(WII_VM)
+   if (boot_cache_armed && bNeoBooted)
+   {
+      boot_cache_armed = false;
+      state_save_start(boot_cache_fs, 1, true);
+   }
+#endif
+
+   if (state_save_pending[0] && BurnStateSaveDone())
+      state_save_collect();
+
    if (!nSkipFrame)
       video_cb(g_fba_frame, width, height, nBurnPitch);
    else
       video_cb(NULL, width, height, nBurnPitch);
 
-   if (low_pass_enabled)
-      low_pass_filter_stereo(g_audio_buf, nBurnSoundLen);
+   if (rewinding)
+      memset(g_audio_buf, 0, nBurnSoundLen * 2 * sizeof(int16_t));
 
-   audio_batch_cb(g_audio_buf, nBurnSoundLen);
+   if (!bBurnNoRender)
+   {
+      if (audio_dsp_active())
+         audio_dsp_process(g_audio_buf, nBurnSoundLen);
+
+      audio_rate_control_update();
+      audio_rate_control_write(g_audio_buf, nBurnSoundLen);
+   }
+   audio_ring_flush();
 
    bool updated = false;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
@@ -2080,6 +2855,19 @@ bool retro_unserialize(const void *data, size_t size)
 {
    if (size != state_size)
       return false;
+
+#if !defined(WII_VM)
+   /* A state loaded before the first frame replaces the boot */
+   boot_cache_pending = false;
+   boot_cache_armed   = false;
+#endif
+
+   /* The movie would go on from the frame it was at */
+   if (BurnMovieStatus() != MOVIE_NONE)
+   {
+      BurnMovieStop();
+      log_cb(RETRO_LOG_WARN, "[FBA] Input movie stopped by loading a state.\n");
+   }
    BurnAcb = burn_read_state_cb;
    read_state_ptr = (const uint8_t*)data;
    BurnAreaScan(ACB_FULLSCAN | ACB_WRITE, 0);
@@ -2904,9 +3692,19 @@ static bool fba_init(unsigned driver, const char *game_zip_name)
 
    BurnDrvInit();
 
+   /* Drop whatever was prefetched but never asked for */
+   archive_close();
+
+   {
+      UINT64 mem_current = 0, mem_peak = 0;
+      BurnGetMemoryUsage(&mem_current, &mem_peak);
+      log_cb(RETRO_LOG_INFO, "[FBA] Driver memory: %u KB in use, %u KB peak while loading.\n",
+            (unsigned)(mem_current >> 10), (unsigned)(mem_peak >> 10));
+   }
+
    char input_fs[1024];
-   snprintf(input_fs, sizeof(input_fs), "%s%c%s.fs", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME));
-   BurnStateLoad(input_fs, 0, NULL);
+   if (snprintf(input_fs, sizeof(input_fs), "%s%c%s.fs", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME)) < (int)sizeof(input_fs))
+      BurnStateLoad(input_fs, 0, NULL);
 
    int width, height;
    BurnDrvGetVisibleSize(&width, &height);
@@ -2994,6 +3792,184 @@ static unsigned int BurnDrvGetIndexByName(const char* name)
 }
 
 
+#if !defined(WII_VM)
+/* Point the Neo Geo ROM cache at <system>/cache/ or shared memory, or disable it */
+static void set_rom_cache_path(void)
+{
+   struct retro_variable var = {0};
+
+   szNeoROMCachePath[0] = '\0';
+   bNeoROMCacheShared   = false;
+
+   if (!is_neogeo_game)
+      return;
+
+   var.key = option_fba_neogeo_rom_cache.key;
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) || !var.value)
+      return;
+
+#if defined(HAVE_SHM)
+   if (strcmp(var.value, "shared") == 0)
+   {
+      bNeoROMCacheShared = true;
+      log_cb(RETRO_LOG_INFO, "Neo Geo ROM cache in shared memory\n");
+      return;
+   }
+#endif
+
+   if (strcmp(var.value, "enabled") != 0)
+      return;
+
+   if (snprintf(szNeoROMCachePath, sizeof(szNeoROMCachePath), "%s%ccache", g_system_dir, slash) >= (int)sizeof(szNeoROMCachePath))
+   {
+      szNeoROMCachePath[0] = '\0';
+      return;
+   }
+   rom_cache_mkdir(szNeoROMCachePath);
+
+   if (snprintf(szNeoROMCachePath, sizeof(szNeoROMCachePath), "%s%ccache%c", g_system_dir, slash, slash) >= (int)sizeof(szNeoROMCachePath))
+   {
+      szNeoROMCachePath[0] = '\0';
+      return;
+   }
+   log_cb(RETRO_LOG_INFO, "Neo Geo ROM cache in %s\n", szNeoROMCachePath);
+}
+
+static UINT32 boot_cache_nvram_crc;
+
+static int burn_boot_cache_nvram_cb(BurnArea *pba)
+{
+   boot_cache_nvram_crc = crc32(boot_cache_nvram_crc, (const Bytef*)pba->Data, pba->nLen);
+   return 0;
+}
+
+/* Each game, BIOS and DIP switch setting keeps only the cache
+ * made last, the NVRAM CRC of which is kept in a .boot file
+ * next to it. Called once the new one has been saved */
+static void boot_cache_save_last(void)
+{
+   unsigned int last_crc;
+   FILE *fp = fopen(boot_cache_last, "rb");
+
+   if (fp)
+   {
+      if (fscanf(fp, "%8x", &last_crc) == 1 && last_crc != boot_cache_nvram_crc)
+      {
+         char last_fs[1024];
+
+         if (snprintf(last_fs, sizeof(last_fs), "%s.%08x.fs", boot_cache_last, last_crc) < (int)sizeof(last_fs))
+            remove(last_fs);
+      }
+      fclose(fp);
+   }
+
+   fp = fopen(boot_cache_last, "wb");
+   if (fp)
+   {
+      fprintf(fp, "%08x\n", boot_cache_nvram_crc);
+      fclose(fp);
+   }
+}
+
+/* Go straight to the point where the BIOS hands over to the
+ * cartridge, using the state saved there by an earlier start
+ * with the same BIOS, DIP switches and NVRAM, or arm
+ * retro_run() to save it. Done before the first frame, once
+ * the frontend has put its save RAM in place, since the BIOS
+ * reads the NVRAM while it starts. The calendar chip is set
+ * again afterwards, the cache holds the time it was made at */
+static void boot_cache_start(void)
+{
+   struct retro_variable var = {0};
+   struct BurnInputInfo bii;
+   UINT32 dip_key = 0;
+   unsigned i;
+   FILE *fp;
+
+   boot_cache_armed = false;
+
+   if (!is_neogeo_game || BurnMovieStatus() != MOVIE_NONE)
+      return;
+
+   var.key = option_fba_neogeo_boot_cache.key;
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) || !var.value || strcmp(var.value, "enabled") != 0)
+      return;
+
+   for (i = 0; BurnDrvGetInputInfo(&bii, i) == 0; i++)
+      if (bii.nType == BIT_DIPSWITCH && bii.pVal)
+         dip_key = dip_key * 31 + *bii.pVal + 1;
+
+   boot_cache_nvram_crc = crc32(0, NULL, 0);
+   BurnAcb = burn_boot_cache_nvram_cb;
+   BurnAreaScan(ACB_NVRAM | ACB_READ, NULL);
+
+   if (snprintf(boot_cache_fs, sizeof(boot_cache_fs), "%s%ccache", g_system_dir, slash) >= (int)sizeof(boot_cache_fs))
+      return;
+   rom_cache_mkdir(boot_cache_fs);
+
+   if (snprintf(boot_cache_last, sizeof(boot_cache_last), "%s%ccache%c%s.%02x.%08x.boot",
+         g_system_dir, slash, slash, BurnDrvGetTextA(DRV_NAME), NeoSystem, dip_key) >= (int)sizeof(boot_cache_last)
+         || snprintf(boot_cache_fs, sizeof(boot_cache_fs), "%s.%08x.fs", boot_cache_last, boot_cache_nvram_crc) >= (int)sizeof(boot_cache_fs))
+      return;
+
+   fp = fopen(boot_cache_fs, "rb");
+   if (!fp)
+   {
+      boot_cache_armed = true;
+      return;
+   }
+   fclose(fp);
+
+   state_save_collect();
+   if (BurnStateLoad(boot_cache_fs, 1, NULL))
+   {
+      log_cb(RETRO_LOG_WARN, "[FBA] Cannot load boot cache %s, making it again\n", boot_cache_fs);
+      boot_cache_armed = true;
+      return;
+   }
+
+   uPD4990ASetTime();
+
+   log_cb(RETRO_LOG_INFO, "[FBA] Loaded boot cache %s\n", boot_cache_fs);
+}
+#endif
+
+/* Start recording or playing <save>/<game>.fbm, as the
+ * core option asks. Only done at load, so that movies
+ * start from power-on */
+static void start_movie(void)
+{
+   struct retro_variable var = {0};
+   char movie[1024];
+   int ret;
+
+   var.key = option_fba_movie.key;
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) || !var.value)
+      return;
+
+   if (snprintf(movie, sizeof(movie), "%s%c%s.fbm", g_save_dir, slash, BurnDrvGetTextA(DRV_NAME)) >= (int)sizeof(movie))
+   {
+      log_cb(RETRO_LOG_ERROR, "[FBA] Input movie path too long\n");
+      return;
+   }
+
+   if (strcmp(var.value, "record") == 0)
+   {
+      if (BurnMovieRecord(movie, 0))
+         log_cb(RETRO_LOG_ERROR, "[FBA] Cannot record input movie %s\n", movie);
+      else
+         log_cb(RETRO_LOG_INFO, "[FBA] Recording input movie %s\n", movie);
+   }
+   else if (strcmp(var.value, "play") == 0)
+   {
+      ret = BurnMoviePlay(movie);
+      if (ret)
+         log_cb(RETRO_LOG_ERROR, "[FBA] Cannot play input movie %s%s\n", movie, ret == 2 ? " (recorded with another game)" : "");
+      else
+         log_cb(RETRO_LOG_INFO, "[FBA] Playing input movie %s\n", movie);
+   }
+}
+
 bool retro_load_game(const struct retro_game_info *info)
 {
    unsigned i;
@@ -3009,26 +3985,26 @@ bool retro_load_game(const struct retro_game_info *info)
    // If save directory is defined use it, ...
    if (environ_cb(RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &dir) && dir)
    {
-      strncpy(g_save_dir, dir, sizeof(g_save_dir));
+      snprintf(g_save_dir, sizeof(g_save_dir), "%s", dir);
       log_cb(RETRO_LOG_INFO, "Setting save dir to %s\n", g_save_dir);
    }
    else
    {
       // ... otherwise use rom directory
-      strncpy(g_save_dir, g_rom_dir, sizeof(g_save_dir));
+      snprintf(g_save_dir, sizeof(g_save_dir), "%s", g_rom_dir);
       log_cb(RETRO_LOG_ERROR, "Save dir not defined => use roms dir %s\n", g_save_dir);
    }
 
    // If system directory is defined use it, ...
    if (environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &dir) && dir)
    {
-      strncpy(g_system_dir, dir, sizeof(g_system_dir));
+      snprintf(g_system_dir, sizeof(g_system_dir), "%s", dir);
       log_cb(RETRO_LOG_INFO, "Setting system dir to %s\n", g_system_dir);
    }
    else
    {
       // ... otherwise use rom directory
-      strncpy(g_system_dir, g_rom_dir, sizeof(g_system_dir));
+      snprintf(g_system_dir, sizeof(g_system_dir), "%s", g_rom_dir);
       log_cb(RETRO_LOG_ERROR, "System dir not defined => use roms dir %s\n", g_system_dir);
    }
 
@@ -3050,11 +4026,24 @@ bool retro_load_game(const struct retro_game_info *info)
       nBurnSoundRate = AUDIO_SAMPLERATE;
       nBurnSoundLen  = AUDIO_SEGMENT_LENGTH;
 
+      audio_rate_control_reset();
+      audio_ring_reset();
+
+#if !defined(WII_VM)
+      set_rom_cache_path();
+#endif
+
       if (!fba_init(i, basename))
          goto error;
 
       driver_inited  = true;
 
+      sram_init();
+      start_movie();
+#if !defined(WII_VM)
+      boot_cache_pending = true;
+#endif
+
       BurnDrvGetFullSize(&width, &height);
 
       g_fba_frame    = (uint16_t*)malloc(width * height * sizeof(uint16_t));
@@ -3074,8 +4063,15 @@ bool retro_load_game_special(unsigned, const struct retro_game_info*, size_t)
 
 void retro_unload_game(void) { }
 unsigned retro_get_region(void) { return RETRO_REGION_NTSC; }
-void *retro_get_memory_data(unsigned) { return 0; }
-size_t retro_get_memory_size(unsigned) { return 0; }
+void *retro_get_memory_data(unsigned id)
+{
+   return (id == RETRO_MEMORY_SAVE_RAM) ? sram_data : NULL;
+}
+
+size_t retro_get_memory_size(unsigned id)
+{
+   return (id == RETRO_MEMORY_SAVE_RAM) ? sram_size : 0;
+}
 unsigned retro_api_version(void) { return RETRO_API_VERSION; }
 
 void retro_set_controller_port_device(unsigned port, unsigned device)
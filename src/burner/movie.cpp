@@ -0,0 +1,368 @@
+// Input Movie module
+//
+// Records the driver's inputs (as BurnDrvGetInputInfo() lists them: joysticks, buttons, DIP
+// switches, ...) frame by frame, and plays them back into the driver, so a run of a game can be
+// repeated exactly. BurnMovieFrame() must be called right before every BurnDrvFrame(), after the
+// frontend has set the inputs; during playback it replaces them with the recorded ones. A movie
+// has no way to follow the driver back to an earlier frame, so the frontend must stop it before
+// loading a state or running frames it is going to take back.
+//
+// A movie file (all values little endian) is
+//
+//   char[4]  "FBMV"
+//   UINT32   version of the library that recorded it
+//   char[32] driver name
+//   UINT32   flags, MOVIE_FROM_STATE if it starts from a saved state, MOVIE_FULL_STATE if the
+//            start state is the whole driver state
+//   UINT32   number of inputs
+//   UINT32   number of frames
+//   UINT32   length of the start state
+//   ...      start state, compressed with deflate as by BurnStateCompress()
+//   ...      frames
+//
+// The start state is the whole driver state, also for movies that start at power-on: that holds
+// the real-time clock, which drivers set from the host's clock when they start up, so a movie
+// played back later starts at the time it was recorded at. Older movies that start at power-on
+// only hold the NVRAM and memory cards, and must be played back straight after the game is
+// loaded. Each frame lists the inputs that changed since the frame before: the
+// number of the input plus one (a byte, or 0xFF and a UINT16 if it's 0xFF or more) followed by its
+// new value (a byte, or a UINT16 for analog inputs), ending with a 0 byte. Every input starts at 0,
+// so a frame in which nothing changed takes a single byte.
+
+#include <stdio.h>
+#include "burner.h"
+
+#define MOVIE_FROM_STATE	(1)
+#define MOVIE_FULL_STATE	(2)
+
+#define MOVIE_HEADER_LEN	(56)
+
+static FILE* fMovie = NULL;				// Movie being recorded
+static UINT8* Movie = NULL;				// Movie being played
+static INT32 nMovieLen = 0;
+static INT32 nMoviePos = 0;
+
+static INT32 nMovieStatus = MOVIE_NONE;
+static INT32 nMovieFrame = 0;
+static INT32 nMovieFrames = 0;
+
+static struct BurnInputInfo* MovieInputs = NULL;
+static UINT16* MovieValues = NULL;		// Value of each input as of the last frame
+static INT32 nMovieInputs = 0;
+
+static void MovieWrite32(UINT8* p, UINT32 n)
+{
+	p[0] = n & 0xFF;
+	p[1] = (n >> 8) & 0xFF;
+	p[2] = (n >> 16) & 0xFF;
+	p[3] = n >> 24;
+}
+
+static UINT32 MovieRead32(const UINT8* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static INT32 MovieInputsInit()
+{
+	struct BurnInputInfo bii;
+
+	for (nMovieInputs = 0; BurnDrvGetInputInfo(&bii, nMovieInputs) == 0; nMovieInputs++) {
+	}
+
+	MovieInputs = (struct BurnInputInfo*)malloc((nMovieInputs + 1) * sizeof(struct BurnInputInfo));
+	MovieValues = (UINT16*)calloc(nMovieInputs + 1, sizeof(UINT16));
+	if (MovieInputs == NULL || MovieValues == NULL) {
+		return 1;
+	}
+
+	for (INT32 i = 0; i < nMovieInputs; i++) {
+		BurnDrvGetInputInfo(&MovieInputs[i], i);
+	}
+
+	return 0;
+}
+
+static inline bool MovieInputIsAnalog(INT32 i)
+{
+	return (MovieInputs[i].nType & BIT_GROUP_ANALOG) && !(MovieInputs[i].nType & BIT_GROUP_CONSTANT);
+}
+
+static UINT16 MovieInputGet(INT32 i)
+{
+	if (MovieInputs[i].pVal == NULL) {
+		return 0;
+	}
+
+	return MovieInputIsAnalog(i) ? *MovieInputs[i].pShortVal : *MovieInputs[i].pVal;
+}
+
+static void MovieInputSet(INT32 i, UINT16 nValue)
+{
+	if (MovieInputs[i].pVal == NULL) {
+		return;
+	}
+
+	if (MovieInputIsAnalog(i)) {
+		*MovieInputs[i].pShortVal = nValue;
+	} else {
+		*MovieInputs[i].pVal = (UINT8)nValue;
+	}
+}
+
+// Decode one frame into MovieValues[], checking it lies within the movie
+static INT32 MovieReadFrame()
+{
+	while (1) {
+		if (nMoviePos >= nMovieLen) {
+			return 1;
+		}
+
+		INT32 nInput = Movie[nMoviePos++];
+		if (nInput == 0) {
+			return 0;
+		}
+		if (nInput == 0xFF) {
+			if (nMovieLen - nMoviePos < 2) {
+				return 1;
+			}
+			nInput = Movie[nMoviePos] | (Movie[nMoviePos + 1] << 8);
+			nMoviePos += 2;
+		}
+		nInput--;
+		if (nInput >= nMovieInputs) {
+			return 1;
+		}
+
+		UINT16 nValue;
+		if (MovieInputIsAnalog(nInput)) {
+			if (nMovieLen - nMoviePos < 2) {
+				return 1;
+			}
+			nValue = Movie[nMoviePos] | (Movie[nMoviePos + 1] << 8);
+			nMoviePos += 2;
+		} else {
+			if (nMovieLen - nMoviePos < 1) {
+				return 1;
+			}
+			nValue = Movie[nMoviePos++];
+		}
+
+		MovieValues[nInput] = nValue;
+	}
+}
+
+static INT32 MovieWriteFrame()
+{
+	UINT8 Frame[8];
+
+	for (INT32 i = 0; i < nMovieInputs; i++) {
+		UINT16 nValue = MovieInputGet(i);
+		INT32 nLen = 0;
+
+		if (nValue == MovieValues[i]) {
+			continue;
+		}
+		MovieValues[i] = nValue;
+
+		if (i + 1 < 0xFF) {
+			Frame[nLen++] = i + 1;
+		} else {
+			Frame[nLen++] = 0xFF;
+			Frame[nLen++] = (i + 1) & 0xFF;
+			Frame[nLen++] = (i + 1) >> 8;
+		}
+		Frame[nLen++] = nValue & 0xFF;
+		if (MovieInputIsAnalog(i)) {
+			Frame[nLen++] = nValue >> 8;
+		}
+
+		if (fwrite(Frame, 1, nLen, fMovie) != (size_t)nLen) {
+			return 1;
+		}
+	}
+
+	return (fputc(0, fMovie) == EOF) ? 1 : 0;
+}
+
+void BurnMovieStop()
+{
+	if (fMovie) {
+		UINT8 Frames[4];
+
+		// The frame count in the header is only written now, it's only there for information
+		MovieWrite32(Frames, nMovieFrame);
+		fseek(fMovie, 48, SEEK_SET);
+		fwrite(Frames, 1, 4, fMovie);
+
+		fclose(fMovie);
+		fMovie = NULL;
+	}
+	if (Movie) {
+		free(Movie);
+		Movie = NULL;
+	}
+	if (MovieInputs) {
+		free(MovieInputs);
+		MovieInputs = NULL;
+	}
+	if (MovieValues) {
+		free(MovieValues);
+		MovieValues = NULL;
+	}
+
+	nMovieLen = 0;
+	nMoviePos = 0;
+	nMovieInputs = 0;
+	nMovieFrame = 0;
+	nMovieFrames = 0;
+	nMovieStatus = MOVIE_NONE;
+}
+
+// Start recording a movie, from the current state if bFromState or else from power-on
+INT32 BurnMovieRecord(TCHAR* szName, INT32 bFromState)
+{
+	UINT8 Header[MOVIE_HEADER_LEN];
+	UINT8* Def = NULL;
+	INT32 nDefLen = 0;
+
+	BurnMovieStop();
+
+	if (MovieInputsInit()) {
+		BurnMovieStop();
+		return 1;
+	}
+
+	if (BurnStateCompress(&Def, &nDefLen, 1, BURN_STATE_DEFLATE)) {
+		BurnMovieStop();
+		return 1;
+	}
+
+	memset(Header, 0, sizeof(Header));
+	memcpy(Header, "FBMV", 4);
+	MovieWrite32(Header + 4, nBurnVer);
+	strncpy((char*)Header + 8, BurnDrvGetTextA(DRV_NAME), 31);
+	MovieWrite32(Header + 40, (bFromState ? MOVIE_FROM_STATE : 0) | MOVIE_FULL_STATE);
+	MovieWrite32(Header + 44, nMovieInputs);
+	MovieWrite32(Header + 48, 0);
+	MovieWrite32(Header + 52, nDefLen);
+
+	fMovie = _tfopen(szName, _T("wb"));
+	if (fMovie == NULL || fwrite(Header, 1, sizeof(Header), fMovie) != sizeof(Header) || fwrite(Def, 1, nDefLen, fMovie) != (size_t)nDefLen) {
+		free(Def);
+		BurnMovieStop();
+		return 1;
+	}
+	free(Def);
+
+	nMovieStatus = MOVIE_RECORD;
+
+	return 0;
+}
+
+// Start playing a movie back. Returns 1 if it can't be read, and 2 if it's for another game
+INT32 BurnMoviePlay(TCHAR* szName)
+{
+	BurnMovieStop();
+
+	FILE* fp = _tfopen(szName, _T("rb"));
+	if (fp == NULL) {
+		return 1;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	nMovieLen = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	Movie = (UINT8*)malloc(nMovieLen + 1);
+	if (Movie == NULL || (INT32)fread(Movie, 1, nMovieLen, fp) != nMovieLen) {
+		fclose(fp);
+		BurnMovieStop();
+		return 1;
+	}
+	fclose(fp);
+
+	if (nMovieLen < MOVIE_HEADER_LEN || memcmp(Movie, "FBMV", 4)) {
+		BurnMovieStop();
+		return 1;
+	}
+
+	char szDriver[32];
+	memcpy(szDriver, Movie + 8, 31);
+	szDriver[31] = '\0';
+
+	if (strcmp(szDriver, BurnDrvGetTextA(DRV_NAME)) || MovieInputsInit() || MovieRead32(Movie + 44) != (UINT32)nMovieInputs) {
+		BurnMovieStop();
+		return 2;
+	}
+
+	INT32 bAll = (MovieRead32(Movie + 40) & (MOVIE_FROM_STATE | MOVIE_FULL_STATE)) ? 1 : 0;
+	UINT32 nDefLen = MovieRead32(Movie + 52);
+	if (nDefLen > (UINT32)(nMovieLen - MOVIE_HEADER_LEN)) {
+		BurnMovieStop();
+		return 1;
+	}
+
+	// Check the whole movie before the state is touched
+	nMoviePos = MOVIE_HEADER_LEN + nDefLen;
+	while (nMoviePos < nMovieLen) {
+		if (MovieReadFrame()) {
+			BurnMovieStop();
+			return 1;
+		}
+		nMovieFrames++;
+	}
+
+	if (BurnStateDecompress(Movie + MOVIE_HEADER_LEN, nDefLen, bAll, BURN_STATE_DEFLATE)) {
+		BurnMovieStop();
+		return 1;
+	}
+
+	memset(MovieValues, 0, nMovieInputs * sizeof(UINT16));
+	nMoviePos = MOVIE_HEADER_LEN + nDefLen;
+	nMovieStatus = MOVIE_PLAYBACK;
+
+	return 0;
+}
+
+// Call before each BurnDrvFrame(). Returns 1 once playback has come to the end of the movie
+INT32 BurnMovieFrame()
+{
+	switch (nMovieStatus) {
+		case MOVIE_RECORD:
+			if (MovieWriteFrame()) {
+				BurnMovieStop();
+				return 1;
+			}
+			nMovieFrame++;
+			break;
+
+		case MOVIE_PLAYBACK:
+			if (nMovieFrame >= nMovieFrames) {
+				BurnMovieStop();
+				return 1;
+			}
+
+			// Inputs which didn't change still have to be set, the frontend has set them since
+			MovieReadFrame();
+			for (INT32 i = 0; i < nMovieInputs; i++) {
+				MovieInputSet(i, MovieValues[i]);
+			}
+			nMovieFrame++;
+			break;
+	}
+
+	return 0;
+}
+
+INT32 BurnMovieStatus()
+{
+	return nMovieStatus;
+}
+
+// Frames recorded or played so far, and the length of the movie being played
+void BurnMovieGetFrames(INT32* pnFrame, INT32* pnFrames)
+{
+	if (pnFrame) *pnFrame = nMovieFrame;
+	if (pnFrames) *pnFrames = (nMovieStatus == MOVIE_PLAYBACK) ? nMovieFrames : nMovieFrame;
+}
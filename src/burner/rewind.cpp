@@ -0,0 +1,235 @@
+// Rewind module
+//
+// Keeps the states of the last frames within a fixed amount of memory, so the game can be stepped
+// back a frame at a time. Only the newest state is kept whole. Every older one is stored as the XOR
+// of itself and the state that followed it, compressed with the fast state codec: a frame changes
+// little of the state, so the XOR is nearly all zeros and packs down to a small fraction of it.
+// Stepping back unpacks the newest delta and XORs it into the newest state, so it costs the same
+// however many frames are kept. When the ring is full the oldest deltas make room for new ones.
+
+#include "burner.h"
+
+struct RewindEntry {
+	INT32 nPos;							// Offset of the compressed delta in the ring
+	INT32 nLen;
+};
+
+static UINT8* RewindState = NULL;		// Newest state
+static UINT8* RewindDelta = NULL;		// XOR of the newest state and the one before it
+static UINT8* RewindComp = NULL;		// Delta being compressed
+static UINT8* RewindRing = NULL;		// Compressed deltas
+static RewindEntry* RewindEntries = NULL;
+static INT32 nRewindStateLen = 0;
+static INT32 nRewindRingLen = 0;
+static INT32 nRewindMaxEntries = 0;
+static INT32 nRewindFirst = 0;			// Oldest entry
+static INT32 nRewindCount = 0;
+static bool bRewindHaveState = false;
+
+static INT32 nRewindPos = 0;
+static bool bRewindOverflow = false;
+
+static INT32 __cdecl RewindLenAcb(struct BurnArea* pba)
+{
+	nRewindStateLen += pba->nLen;
+
+	return 0;
+}
+
+// Make the delta from the newest state to this one, and make this one the newest
+static INT32 __cdecl RewindPushAcb(struct BurnArea* pba)
+{
+	UINT8* pSrc = (UINT8*)pba->Data;
+
+	if (nRewindPos + (INT32)pba->nLen > nRewindStateLen) {
+		bRewindOverflow = true;
+		return 0;
+	}
+
+	UINT8* pState = RewindState + nRewindPos;
+	UINT8* pDelta = RewindDelta + nRewindPos;
+	for (UINT32 i = 0; i < pba->nLen; i++) {
+		pDelta[i] = pState[i] ^ pSrc[i];
+		pState[i] = pSrc[i];
+	}
+	nRewindPos += pba->nLen;
+
+	return 0;
+}
+
+static INT32 __cdecl RewindLoadAcb(struct BurnArea* pba)
+{
+	if (nRewindPos + (INT32)pba->nLen > nRewindStateLen) {
+		bRewindOverflow = true;
+		return 0;
+	}
+
+	memcpy(pba->Data, RewindState + nRewindPos, pba->nLen);
+	nRewindPos += pba->nLen;
+
+	return 0;
+}
+
+void BurnRewindExit()
+{
+	if (RewindState) {
+		free(RewindState);
+		RewindState = NULL;
+	}
+	if (RewindDelta) {
+		free(RewindDelta);
+		RewindDelta = NULL;
+	}
+	if (RewindComp) {
+		free(RewindComp);
+		RewindComp = NULL;
+	}
+	if (RewindRing) {
+		free(RewindRing);
+		RewindRing = NULL;
+	}
+	if (RewindEntries) {
+		free(RewindEntries);
+		RewindEntries = NULL;
+	}
+
+	nRewindStateLen = 0;
+	nRewindRingLen = 0;
+	nRewindMaxEntries = 0;
+	nRewindFirst = 0;
+	nRewindCount = 0;
+	bRewindHaveState = false;
+}
+
+// Set up rewinding for the running driver, using about nBudget bytes of memory in all
+INT32 BurnRewindInit(INT32 nBudget)
+{
+	BurnRewindExit();
+
+	BurnAcb = RewindLenAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+
+	if (nRewindStateLen <= 0) {
+		return 1;
+	}
+
+	// An unchanged frame still takes about 1/255 of the state, so there can't be more entries than this
+	INT32 nCompLen = BurnStateFastBound(nRewindStateLen);
+	nRewindRingLen = nBudget - nRewindStateLen * 2 - nCompLen;
+	nRewindMaxEntries = nRewindRingLen / (nRewindStateLen / 255 + 1) + 1;
+	nRewindRingLen -= nRewindMaxEntries * sizeof(RewindEntry);
+	if (nRewindRingLen < nCompLen) {
+		BurnRewindExit();
+		return 1;
+	}
+
+	RewindState = (UINT8*)malloc(nRewindStateLen);
+	RewindDelta = (UINT8*)malloc(nRewindStateLen);
+	RewindComp = (UINT8*)malloc(nCompLen);
+	RewindRing = (UINT8*)malloc(nRewindRingLen);
+	RewindEntries = (RewindEntry*)malloc(nRewindMaxEntries * sizeof(RewindEntry));
+	if (RewindState == NULL || RewindDelta == NULL || RewindComp == NULL || RewindRing == NULL || RewindEntries == NULL) {
+		BurnRewindExit();
+		return 1;
+	}
+
+	return 0;
+}
+
+// Add the current state as the newest frame. Call once a frame, after the frame has been run
+INT32 BurnRewindPush()
+{
+	if (RewindState == NULL) {
+		return 1;
+	}
+
+	nRewindPos = 0;
+	bRewindOverflow = false;
+
+	BurnAcb = RewindPushAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+
+	if (bRewindOverflow || nRewindPos != nRewindStateLen) {
+		// The older deltas can't be trusted to lead back from this state
+		bRewindHaveState = false;
+		nRewindCount = 0;
+		return 1;
+	}
+
+	if (!bRewindHaveState) {
+		// Nothing to make a delta against yet, this is the first frame that can be gone back to
+		bRewindHaveState = true;
+		return 0;
+	}
+
+	INT32 nLen = BurnStateFastCompress(RewindDelta, nRewindStateLen, RewindComp);
+
+	// Place the delta after the newest one, or at the start of the ring if it doesn't fit
+	INT32 nNewestEnd = 0;
+	if (nRewindCount) {
+		RewindEntry* pNewest = &RewindEntries[(nRewindFirst + nRewindCount - 1) % nRewindMaxEntries];
+		nNewestEnd = pNewest->nPos + pNewest->nLen;
+	}
+	INT32 nPos = nNewestEnd;
+	bool bWrap = false;
+	if (nPos + nLen > nRewindRingLen) {
+		nPos = 0;
+		bWrap = true;
+	}
+
+	// Going from the oldest entry, the entries lie from the newest one's end to the end of the ring, then
+	// from the start of the ring up to the newest one. Free space by dropping the oldest: on a wrap all of
+	// those past the newest one go, as the ring starts over, then any the new delta overlaps
+	while (nRewindCount) {
+		RewindEntry* pOldest = &RewindEntries[nRewindFirst];
+
+		if (nRewindCount < nRewindMaxEntries && !(bWrap && pOldest->nPos >= nNewestEnd) && (pOldest->nPos >= nPos + nLen || pOldest->nPos + pOldest->nLen <= nPos)) {
+			break;
+		}
+
+		nRewindFirst = (nRewindFirst + 1) % nRewindMaxEntries;
+		nRewindCount--;
+	}
+
+	RewindEntry* pEntry = &RewindEntries[(nRewindFirst + nRewindCount) % nRewindMaxEntries];
+	pEntry->nPos = nPos;
+	pEntry->nLen = nLen;
+	memcpy(RewindRing + nPos, RewindComp, nLen);
+	nRewindCount++;
+
+	return 0;
+}
+
+// Go back to the frame before the newest one, which then becomes the newest. Fails if there is none
+INT32 BurnRewindStep()
+{
+	if (RewindState == NULL || nRewindCount == 0) {
+		return 1;
+	}
+
+	RewindEntry* pEntry = &RewindEntries[(nRewindFirst + nRewindCount - 1) % nRewindMaxEntries];
+	if (BurnStateFastDecompress(RewindRing + pEntry->nPos, pEntry->nLen, RewindDelta, nRewindStateLen)) {
+		bRewindHaveState = false;
+		nRewindCount = 0;
+		return 1;
+	}
+	nRewindCount--;
+
+	for (INT32 i = 0; i < nRewindStateLen; i++) {
+		RewindState[i] ^= RewindDelta[i];
+	}
+
+	nRewindPos = 0;
+	bRewindOverflow = false;
+
+	BurnAcb = RewindLoadAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_WRITE, NULL);
+
+	return bRewindOverflow ? 1 : 0;
+}
+
+// Number of frames that can be gone back
+INT32 BurnRewindFrames()
+{
+	return nRewindCount;
+}
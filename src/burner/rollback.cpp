@@ -0,0 +1,199 @@
+// Rollback module
+//
+// Support for rollback netplay on top of BurnDrvFrame(). The driver state is
+// snapshotted every frame with the state delta module, and the undo record of
+// each snapshot (the old contents of the pages that changed since the one
+// before) is kept in a ring, tagged with the frame it belongs to. A frame
+// usually changes only a few pages of the state, so the ring holds far more
+// frames than full copies would in the same memory. When a late input arrives
+// the caller loads the frame it applies to, which undoes the newer snapshots
+// one by one, and resimulates up to the present with BurnRollbackRun(). That
+// runs the frames with bBurnNoRender set, so nothing is drawn and no sound
+// synthesised. That doesn't change the emulation, so the resimulated frames
+// come out exactly as they would have been played; BurnRollbackChecksum() can
+// be used to check that both peers agree (statediff -b does so for a game).
+
+#include "zlib.h"
+
+#include "burner.h"
+
+struct RollbackEntry {
+	INT32 nFrame;
+	UINT8* pUndo;						// Undo record back to the entry before
+	INT32 nLen;
+	INT32 nAlloc;
+};
+
+static RollbackEntry* RollbackEntries = NULL;
+static INT32 nRollbackSlots = 0;
+static INT32 nRollbackFirst = 0;		// Oldest entry
+static INT32 nRollbackCount = 0;
+
+static UINT32 nRollbackCrc = 0;
+
+static INT32 __cdecl RollbackCrcAcb(struct BurnArea* pba)
+{
+	nRollbackCrc = crc32(nRollbackCrc, (const Bytef*)pba->Data, pba->nLen);
+
+	return 0;
+}
+
+static inline RollbackEntry* RollbackAt(INT32 i)
+{
+	return &RollbackEntries[(nRollbackFirst + i) % nRollbackSlots];
+}
+
+// Forget every saved frame and start again from the current state
+static INT32 RollbackRestart()
+{
+	nRollbackFirst = 0;
+	nRollbackCount = 0;
+
+	return BurnStateDeltaInit();
+}
+
+void BurnRollbackExit()
+{
+	if (RollbackEntries) {
+		for (INT32 i = 0; i < nRollbackSlots; i++) {
+			free(RollbackEntries[i].pUndo);
+		}
+		free(RollbackEntries);
+		RollbackEntries = NULL;
+	}
+
+	BurnStateDeltaExit();
+
+	nRollbackSlots = 0;
+	nRollbackFirst = 0;
+	nRollbackCount = 0;
+}
+
+// Size the ring for the running driver. nSlots should cover the longest rollback expected, plus one
+INT32 BurnRollbackInit(INT32 nSlots)
+{
+	BurnRollbackExit();
+
+	if (nSlots <= 0) {
+		return 1;
+	}
+
+	RollbackEntries = (RollbackEntry*)calloc(nSlots, sizeof(RollbackEntry));
+	if (RollbackEntries == NULL) {
+		return 1;
+	}
+	nRollbackSlots = nSlots;
+
+	if (RollbackRestart()) {
+		BurnRollbackExit();
+		return 1;
+	}
+
+	return 0;
+}
+
+// Save the current state as that of frame nFrame, replacing the oldest frame in the ring
+INT32 BurnRollbackSave(INT32 nFrame)
+{
+	UINT8* pDelta;
+	INT32 nLen;
+
+	if (RollbackEntries == NULL || nFrame < 0) {
+		return 1;
+	}
+
+	if (BurnStateDeltaSave(&pDelta, &nLen)) {
+		// The snapshot can't be trusted any more, nor can the frames before it be reached from it
+		RollbackRestart();
+		return 1;
+	}
+
+	if (nRollbackCount == nRollbackSlots) {
+		nRollbackFirst = (nRollbackFirst + 1) % nRollbackSlots;
+		nRollbackCount--;
+	}
+
+	RollbackEntry* pEntry = RollbackAt(nRollbackCount);
+	if (pEntry->nAlloc < nLen) {
+		UINT8* pUndo = (UINT8*)realloc(pEntry->pUndo, nLen);
+		if (pUndo == NULL) {
+			RollbackRestart();
+			return 1;
+		}
+		pEntry->pUndo = pUndo;
+		pEntry->nAlloc = nLen;
+	}
+
+	memcpy(pEntry->pUndo, pDelta, nLen);
+	pEntry->nLen = nLen;
+	pEntry->nFrame = nFrame;
+	nRollbackCount++;
+
+	return 0;
+}
+
+// Go back to the state last saved for frame nFrame. Fails if that frame has left the ring. Frames saved
+// after it are dropped
+INT32 BurnRollbackLoad(INT32 nFrame)
+{
+	INT32 nEntry;
+
+	if (RollbackEntries == NULL || nFrame < 0) {
+		return 1;
+	}
+
+	for (nEntry = nRollbackCount - 1; nEntry >= 0; nEntry--) {
+		if (RollbackAt(nEntry)->nFrame == nFrame) {
+			break;
+		}
+	}
+	if (nEntry < 0) {
+		return 1;
+	}
+
+	while (nRollbackCount > nEntry + 1) {
+		RollbackEntry* pEntry = RollbackAt(nRollbackCount - 1);
+
+		if (BurnStateDeltaUndo(pEntry->pUndo, pEntry->nLen)) {
+			RollbackRestart();
+			return 1;
+		}
+		nRollbackCount--;
+	}
+
+	return BurnStateDeltaLoad();
+}
+
+// Run nFrames frames without video or audio output. pSetInputs (if any) is called before each
+// frame with its index, and should set the inputs as they were (or are now known to be) for it
+INT32 BurnRollbackRun(INT32 nFrames, void (*pSetInputs)(INT32 nFrame))
+{
+	UINT8* pDraw = pBurnDraw;
+	bool bNoRender = bBurnNoRender;
+
+	pBurnDraw = NULL;
+	bBurnNoRender = true;
+
+	for (INT32 i = 0; i < nFrames; i++) {
+		if (pSetInputs) {
+			pSetInputs(i);
+		}
+		BurnDrvFrame();
+	}
+
+	pBurnDraw = pDraw;
+	bBurnNoRender = bNoRender;
+
+	return 0;
+}
+
+// CRC of the whole driver state, for checking that two machines (or two runs) are in step
+UINT32 BurnRollbackChecksum()
+{
+	nRollbackCrc = crc32(0, NULL, 0);
+
+	BurnAcb = RollbackCrcAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+
+	return nRollbackCrc;
+}
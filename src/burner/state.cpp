@@ -2,12 +2,24 @@
 #include <stdio.h>
 #include "burner.h"
 
+#if defined(_WIN32)
+ #include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+ #include <unistd.h>
+#endif
+
 UINT32 nReplayCurrentFrame;
 UINT32 nStartFrame;
 
+INT32 nBurnStateCodec = BURN_STATE_DEFLATE;				// Codec for the states saved from now on
+
 // If bAll=0 save/load all non-volatile ram to .fs
 // If bAll=1 save/load all ram to .fs
 
+// The first reserved word of a chunk holds the codec of its data block, which is 0 (deflate) in states
+// saved before there was a choice. States using another codec are marked as needing this version, so
+// that older versions refuse them instead of loading garbage
+
 // ------------ State len --------------------
 static INT32 nTotalLen = 0;
 
@@ -55,6 +67,7 @@ INT32 BurnStateLoadEmbed(FILE* fp, INT32 nOffset, INT32 bAll, INT32 (*pLoadGame)
 	INT32 nChunkSize = 0;
 	UINT8 *Def = NULL;
 	INT32 nDefLen = 0;									// Deflated version
+	INT32 nCodec = 0;
 	INT32 nRet = 0;
 
 	if (nOffset >= 0) {
@@ -155,7 +168,9 @@ INT32 BurnStateLoadEmbed(FILE* fp, INT32 nOffset, INT32 bAll, INT32 (*pLoadGame)
 	fread(&nReplayCurrentFrame, 1, 4, fp);
 	nCurrentFrame = nStartFrame + nReplayCurrentFrame;
 
-	fseek(fp, 0x0C, SEEK_CUR);							// Move file pointer to the start of the compressed block
+	fread(&nCodec, 1, 4, fp);							// Codec of the compressed block
+
+	fseek(fp, 0x08, SEEK_CUR);							// Move file pointer to the start of the compressed block
 	Def = (UINT8*)malloc(nDefLen);
 	if (Def == NULL) {
 		return -1;
@@ -163,7 +178,7 @@ INT32 BurnStateLoadEmbed(FILE* fp, INT32 nOffset, INT32 bAll, INT32 (*pLoadGame)
 	memset(Def, 0, nDefLen);
 	fread(Def, 1, nDefLen, fp);							// Read in deflated block
 
-	nRet = BurnStateDecompress(Def, nDefLen, bAll);		// Decompress block into driver
+	nRet = BurnStateDecompress(Def, nDefLen, bAll, nCodec);	// Decompress block into driver
 	free(Def);											// free deflated block
 
 	fseek(fp, nChunkData + nChunkSize, SEEK_SET);
@@ -174,6 +189,8 @@ INT32 BurnStateLoadEmbed(FILE* fp, INT32 nOffset, INT32 bAll, INT32 (*pLoadGame)
    return 0;
 }
 
+static void StateSaveCollect();
+
 // State load
 INT32 BurnStateLoad(TCHAR* szName, INT32 bAll, INT32 (*pLoadGame)())
 {
@@ -181,6 +198,8 @@ INT32 BurnStateLoad(TCHAR* szName, INT32 bAll, INT32 (*pLoadGame)())
 	char szReadHeader[4] = "";
 	INT32 nRet = 0;
 
+	StateSaveCollect();									// The state may still be being written
+
 	FILE* fp = _tfopen(szName, _T("rb"));
 	if (fp == NULL) {
 		return 1;
@@ -199,74 +218,72 @@ INT32 BurnStateLoad(TCHAR* szName, INT32 bAll, INT32 (*pLoadGame)())
    return 0;
 }
 
-// Write a savestate as a chunk of an "FB1 " file
-// nOffset is the absolute offset from the beginning of the file
-// -1: Append at current position
-// -2: Append at EOF
-INT32 BurnStateSaveEmbed(FILE* fp, INT32 nOffset, INT32 bAll)
-{
-	const char* szHeader = "FS1 ";						// Chunk identifier
-
-	INT32 nLen = 0;
-	INT32 nNvMin = 0, nAMin = 0;
-	INT32 nZero = 0;
+// Everything that goes in the header of a chunk, gathered while the driver is stopped
+struct StateChunkInfo {
+	INT32 nNvMin;
+	INT32 nAMin;
 	char szGame[33];
-	UINT8 *Def = NULL;
-	INT32 nDefLen = 0;									// Deflated version
-	INT32 nRet = 0;
+	UINT32 nFrame;
+	INT32 nCodec;
+};
 
-	if (fp == NULL) {
-		return -1;
-	}
+static INT32 StateChunkInfoGet(StateChunkInfo* pInfo, INT32 bAll, INT32 nCodec)
+{
+	INT32 nLen = 0;
 
-	StateInfo(&nLen, &nNvMin, 0);						// Get minimum version for NV part
-	nAMin = nNvMin;
+	StateInfo(&nLen, &pInfo->nNvMin, 0);				// Get minimum version for NV part
+	pInfo->nAMin = pInfo->nNvMin;
 	if (bAll) {											// Get minimum version for All data
-		StateInfo(&nLen, &nAMin, 1);
+		StateInfo(&nLen, &pInfo->nAMin, 1);
 	}
 
 	if (nLen <= 0) {									// No memory to save
-		return -1;
+		return 1;
 	}
 
-	if (nOffset >= 0) {
-		fseek(fp, nOffset, SEEK_SET);
-	} else {
-		if (nOffset == -2) {
-			fseek(fp, 0, SEEK_END);
-		} else {
-			fseek(fp, 0, SEEK_CUR);
-		}
+	if (nCodec != BURN_STATE_DEFLATE) {
+		pInfo->nNvMin = nBurnVer;
+		pInfo->nAMin = nBurnVer;
 	}
 
+	memset(pInfo->szGame, 0, sizeof(pInfo->szGame));	// Game name
+	sprintf(pInfo->szGame, "%.32s", BurnDrvGetTextA(DRV_NAME));
+
+	nReplayCurrentFrame = GetCurrentFrame() - nStartFrame;
+	pInfo->nFrame = nReplayCurrentFrame;
+
+	pInfo->nCodec = nCodec;
+
+	return 0;
+}
+
+// Write a chunk at the current position, returns its size
+static INT32 StateChunkWrite(FILE* fp, StateChunkInfo* pInfo, UINT8* Def, INT32 nDefLen)
+{
+	const char* szHeader = "FS1 ";						// Chunk identifier
+
+	INT32 nZero = 0;
+	INT32 nRet = 0;
+
 	fwrite(szHeader, 1, 4, fp);							// Chunk identifier
 	INT32 nSizeOffset = ftell(fp);						// Reserve space to write the size of this chunk
 	fwrite(&nZero, 1, 4, fp);							//
 
 	fwrite(&nBurnVer, 1, 4, fp);						// Version of FB this was saved from
-	fwrite(&nNvMin, 1, 4, fp);							// Min version of FB NV  data will work with
-	fwrite(&nAMin, 1, 4, fp);							// Min version of FB All data will work with
+	fwrite(&pInfo->nNvMin, 1, 4, fp);					// Min version of FB NV  data will work with
+	fwrite(&pInfo->nAMin, 1, 4, fp);					// Min version of FB All data will work with
 
 	fwrite(&nZero, 1, 4, fp);							// Reserve space to write the compressed data size
 
-	memset(szGame, 0, sizeof(szGame));					// Game name
-	sprintf(szGame, "%.32s", BurnDrvGetTextA(DRV_NAME));			//
-	fwrite(szGame, 1, 32, fp);							//
+	fwrite(pInfo->szGame, 1, 32, fp);					// Game name
 
-	nReplayCurrentFrame = GetCurrentFrame() - nStartFrame;
-	fwrite(&nReplayCurrentFrame, 1, 4, fp);					// Current frame
+	fwrite(&pInfo->nFrame, 1, 4, fp);					// Current frame
 
+	fwrite(&pInfo->nCodec, 1, 4, fp);					// Codec of the compressed block
 	fwrite(&nZero, 1, 4, fp);							// Reserved
 	fwrite(&nZero, 1, 4, fp);							//
-	fwrite(&nZero, 1, 4, fp);							//
-
-	nRet = BurnStateCompress(&Def, &nDefLen, bAll);		// Compress block from driver and return deflated buffer
-	if (Def == NULL) {
-		return -1;
-	}
 
 	nRet = fwrite(Def, 1, nDefLen, fp);					// Write block to disk
-	free(Def);											// free deflated block and close file
 
 	if (nRet != nDefLen) {								// error writing block to disk
 		return -1;
@@ -289,6 +306,46 @@ INT32 BurnStateSaveEmbed(FILE* fp, INT32 nOffset, INT32 bAll)
 	return nDefLen;
 }
 
+// Write a savestate as a chunk of an "FB1 " file
+// nOffset is the absolute offset from the beginning of the file
+// -1: Append at current position
+// -2: Append at EOF
+INT32 BurnStateSaveEmbed(FILE* fp, INT32 nOffset, INT32 bAll)
+{
+	StateChunkInfo Info;
+	UINT8 *Def = NULL;
+	INT32 nDefLen = 0;									// Deflated version
+	INT32 nRet = 0;
+
+	if (fp == NULL) {
+		return -1;
+	}
+
+	if (StateChunkInfoGet(&Info, bAll, nBurnStateCodec)) {
+		return -1;
+	}
+
+	if (nOffset >= 0) {
+		fseek(fp, nOffset, SEEK_SET);
+	} else {
+		if (nOffset == -2) {
+			fseek(fp, 0, SEEK_END);
+		} else {
+			fseek(fp, 0, SEEK_CUR);
+		}
+	}
+
+	BurnStateCompress(&Def, &nDefLen, bAll, nBurnStateCodec);	// Compress block from driver and return deflated buffer
+	if (Def == NULL) {
+		return -1;
+	}
+
+	nRet = StateChunkWrite(fp, &Info, Def, nDefLen);
+	free(Def);											// free deflated block
+
+	return nRet;
+}
+
 #ifdef BUILD_WIN32
 INT32 FileExists(const TCHAR *fileName)
 {
@@ -298,22 +355,8 @@ INT32 FileExists(const TCHAR *fileName)
 }
 #endif
 
-// State save
-INT32 BurnStateSave(TCHAR* szName, INT32 bAll)
+static void StateBackup(TCHAR* szName)
 {
-	const char szHeader[] = "FB1 ";						// File identifier
-	INT32 nLen = 0, nVer = 0;
-	INT32 nRet = 0;
-
-	if (bAll) {											// Get amount of data
-		StateInfo(&nLen, &nVer, 1);
-	} else {
-		StateInfo(&nLen, &nVer, 0);
-	}
-	if (nLen <= 0) {									// No data, so exit without creating a savestate
-		return 0;										// Don't return an error code
-	}
-
 #ifdef BUILD_WIN32
 	/*
 	 Save State backups - used in conjunction with BurnStateUNDO();
@@ -340,6 +383,27 @@ INT32 BurnStateSave(TCHAR* szName, INT32 bAll)
 		}
 	}
 #endif
+}
+
+// State save
+INT32 BurnStateSave(TCHAR* szName, INT32 bAll)
+{
+	const char szHeader[] = "FB1 ";						// File identifier
+	INT32 nLen = 0, nVer = 0;
+	INT32 nRet = 0;
+
+	StateSaveCollect();									// Don't write the file twice at the same time
+
+	if (bAll) {											// Get amount of data
+		StateInfo(&nLen, &nVer, 1);
+	} else {
+		StateInfo(&nLen, &nVer, 0);
+	}
+	if (nLen <= 0) {									// No data, so exit without creating a savestate
+		return 0;										// Don't return an error code
+	}
+
+	StateBackup(szName);
 
 	FILE* fp = _tfopen(szName, _T("wb"));
 	if (fp == NULL) {
@@ -356,3 +420,154 @@ INT32 BurnStateSave(TCHAR* szName, INT32 bAll)
 
    return 0;
 }
+
+// ------------ Background save --------------------
+// Only the snapshot of the state is taken on the calling thread. Compressing it and writing the file
+// are left to a thread of their own, so the emulation carries on without a hitch
+
+struct StateSaveJob {
+	TCHAR* szName;
+	StateChunkInfo Info;
+	UINT8* Raw;
+	INT32 nRawLen;
+	INT32 nRet;
+};
+
+static StateSaveJob* pStateSaveJob = NULL;
+static BurnThreadTask* pStateSaveTask = NULL;
+static INT32 nStateSaveRet = 0;							// Result not yet returned by BurnStateSaveWait()
+
+// Get a file's data onto the disk, where the platform has a way to. Returns 1 on errors
+static INT32 StateFileSync(FILE* fp)
+{
+	if (fflush(fp)) {
+		return 1;
+	}
+
+#if defined(_WIN32)
+	return _commit(_fileno(fp)) ? 1 : 0;
+#elif defined(__unix__) || defined(__APPLE__)
+	return fsync(fileno(fp)) ? 1 : 0;
+#else
+	return 0;
+#endif
+}
+
+static void StateSaveJobRun(INT32, void* pParam)
+{
+	const char szHeader[] = "FB1 ";						// File identifier
+	StateSaveJob* pJob = (StateSaveJob*)pParam;
+	UINT8* Def = NULL;
+	INT32 nDefLen = 0;
+
+	pJob->nRet = 1;
+
+	BurnStateCompressRaw(pJob->Raw, pJob->nRawLen, pJob->Info.nCodec, &Def, &nDefLen);
+	if (Def == NULL) {
+		return;
+	}
+
+	// Write a new file and only then put it in place of the old one, so that a crash (or a power cut)
+	// in the middle of writing can't leave just part of a state behind. The new file has to be on the
+	// disk before the rename is, or a power cut could still leave an empty file under the old name
+	TCHAR* szTemp = (TCHAR*)malloc((_tcslen(pJob->szName) + 5) * sizeof(TCHAR));
+	if (szTemp == NULL) {
+		free(Def);
+		return;
+	}
+	_stprintf(szTemp, _T("%s.tmp"), pJob->szName);
+
+	FILE* fp = _tfopen(szTemp, _T("wb"));
+	if (fp) {
+		INT32 nRet;
+
+		fwrite(&szHeader, 1, 4, fp);
+		nRet = StateChunkWrite(fp, &pJob->Info, Def, nDefLen);
+		if (nRet >= 0 && StateFileSync(fp)) {
+			nRet = -1;
+		}
+
+		if (fclose(fp) == 0 && nRet >= 0) {
+			StateBackup(pJob->szName);
+			pJob->nRet = _trename(szTemp, pJob->szName) ? 1 : 0;
+			if (pJob->nRet) {								// Fails on Windows if the file exists
+				_tremove(pJob->szName);
+				pJob->nRet = _trename(szTemp, pJob->szName) ? 1 : 0;
+			}
+		} else {
+			_tremove(szTemp);
+		}
+	}
+
+	free(szTemp);
+	free(Def);
+}
+
+// Wait for the last background save to finish, keeping its result for BurnStateSaveWait()
+static void StateSaveCollect()
+{
+	if (pStateSaveJob == NULL) {
+		return;
+	}
+
+	BurnThreadWait(pStateSaveTask);
+	pStateSaveTask = NULL;
+
+	nStateSaveRet |= pStateSaveJob->nRet;
+
+	free(pStateSaveJob->Raw);
+	free(pStateSaveJob->szName);
+	free(pStateSaveJob);
+	pStateSaveJob = NULL;
+}
+
+// Returns nonzero if no background save is being written, so BurnStateSaveWait() won't block
+INT32 BurnStateSaveDone()
+{
+	return BurnThreadDone(pStateSaveTask);
+}
+
+// Wait for the last background save to finish. Returns nonzero if it, or one before it that was
+// finished off by another state function since the last call, failed
+INT32 BurnStateSaveWait()
+{
+	INT32 nRet;
+
+	StateSaveCollect();
+
+	nRet = nStateSaveRet;
+	nStateSaveRet = 0;
+
+	return nRet;
+}
+
+// State save, returning as soon as the state has been copied out of the driver
+INT32 BurnStateSaveBackground(TCHAR* szName, INT32 bAll)
+{
+	StateSaveJob* pJob;
+
+	StateSaveCollect();
+
+	pJob = (StateSaveJob*)calloc(1, sizeof(StateSaveJob));
+	if (pJob == NULL) {
+		return 1;
+	}
+
+	if (StateChunkInfoGet(&pJob->Info, bAll, nBurnStateCodec)) {
+		free(pJob);										// No data, so exit without creating a savestate
+		return 0;
+	}
+
+	pJob->szName = (TCHAR*)malloc((_tcslen(szName) + 1) * sizeof(TCHAR));
+	if (pJob->szName == NULL || BurnStateSnapshot(&pJob->Raw, &pJob->nRawLen, bAll)) {
+		free(pJob->szName);
+		free(pJob);
+		return 1;
+	}
+	_tcscpy(pJob->szName, szName);
+
+	pStateSaveJob = pJob;
+	pStateSaveTask = BurnThreadStart(StateSaveJobRun, pJob);
+
+	return 0;
+}
@@ -1,139 +1,395 @@
 // Driver State Compression module
 #include "zlib.h"
 
-#include "burnint.h"
+#include "burner.h"
 
-static UINT8* Comp = NULL;		// Compressed data buffer
-static INT32 nCompLen = 0;
-static INT32 nCompFill = 0;				// How much of the buffer has been filled so far
+// A state is first copied out of the driver in one go, and then compressed as a single block into a
+// buffer sized up front for the worst case. Only the copy has to be made while the driver is stopped,
+// so BurnStateCompressRaw() can run on another thread.
+//
+// BURN_STATE_DEFLATE blocks are a zlib stream, as they always have been. BURN_STATE_FAST blocks hold
+// the length and the CRC32 of the state (UINT32s, little endian) followed by a single block in the LZ4
+// block format, which compresses several times faster than deflate at its fastest setting.
 
-static z_stream Zstr;					// Deflate stream
+static UINT8* StateRaw = NULL;			// Raw state being copied to or from the driver
+static INT32 nStateRawLen = 0;
+static INT32 nStateRawPos = 0;
 
-// -----------------------------------------------------------------------------
-// Compression
+static z_stream Zstr;					// Inflate stream
 
-static INT32 CompEnlarge(INT32 nAdd)
+static INT32 __cdecl StateRawLenAcb(struct BurnArea* pba)
 {
-	void* NewMem = NULL;
+	nStateRawLen += pba->nLen;
 
-	// Need to make more room in the compressed buffer
-	NewMem = realloc(Comp, nCompLen + nAdd);
-	if (NewMem == NULL) {
-		return 1;
+	return 0;
+}
+
+static INT32 __cdecl StateRawReadAcb(struct BurnArea* pba)
+{
+	if (nStateRawPos + (INT32)pba->nLen <= nStateRawLen) {
+		memcpy(StateRaw + nStateRawPos, pba->Data, pba->nLen);
 	}
+	nStateRawPos += pba->nLen;
 
-	Comp = (UINT8*)NewMem;
-	memset(Comp + nCompLen, 0, nAdd);
-	nCompLen += nAdd;
+	return 0;
+}
+
+static INT32 __cdecl StateRawWriteAcb(struct BurnArea* pba)
+{
+	if (nStateRawPos + (INT32)pba->nLen <= nStateRawLen) {
+		memcpy(pba->Data, StateRaw + nStateRawPos, pba->nLen);
+	}
+	nStateRawPos += pba->nLen;
 
 	return 0;
 }
 
-static INT32 CompGo(INT32 bFinish)
+static INT32 StateRawLen(INT32 bAll)
 {
-	INT32 nResult = 0;
-	INT32 nAvailOut = 0;
+	nStateRawLen = 0;
 
-	bool bRetry, bOverflow;
+	BurnAcb = StateRawLenAcb;
 
-	do {
+	if (bAll) BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+	else      BurnAreaScan(ACB_NVRAM    | ACB_READ, NULL);
 
-		bRetry = false;
+	return nStateRawLen;
+}
 
-		// Point to the remainder of out buffer
-		Zstr.next_out = Comp + nCompFill;
-		nAvailOut = nCompLen - nCompFill;
-		if (nAvailOut < 0) {
-			nAvailOut = 0;
-		}
-		Zstr.avail_out = nAvailOut;
+// -----------------------------------------------------------------------------
+// Fast codec (LZ4 block format)
+
+#define FAST_HASH_BITS		(12)
+#define FAST_MIN_MATCH		(4)
+#define FAST_MF_LIMIT		(12)			// No match may start in the last 12 bytes...
+#define FAST_LAST_LITERALS	(5)				// ...or end in the last 5
+#define FAST_MAX_OFFSET		(65535)
+
+#define FAST_BOUND(n)		((n) + (n) / 255 + 16)
+#define FAST_HEADER_LEN		(8)
+
+static inline UINT32 FastRead32(const UINT8* p)
+{
+	UINT32 n;
+	memcpy(&n, p, sizeof(n));
+	return n;
+}
+
+static inline void FastWrite32LE(UINT8* p, UINT32 n)
+{
+	p[0] = n & 0xFF;
+	p[1] = (n >> 8) & 0xFF;
+	p[2] = (n >> 16) & 0xFF;
+	p[3] = (n >> 24) & 0xFF;
+}
+
+static inline UINT32 FastRead32LE(const UINT8* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static inline UINT8* FastPutLength(UINT8* pDest, INT32 nLen)
+{
+	while (nLen >= 255) {
+		*pDest++ = 255;
+		nLen -= 255;
+	}
+	*pDest++ = nLen;
+
+	return pDest;
+}
+
+static UINT8* FastPutLiterals(UINT8* pDest, UINT8* pToken, const UINT8* pSrc, INT32 nLen)
+{
+	if (nLen >= 15) {
+		*pToken = 15 << 4;
+		pDest = FastPutLength(pDest, nLen - 15);
+	} else {
+		*pToken = nLen << 4;
+	}
+
+	memcpy(pDest, pSrc, nLen);
+
+	return pDest + nLen;
+}
 
-		// Try to deflate into the buffer (there may not be enough room though)
-		if (bFinish) {
-			nResult = deflate(&Zstr, Z_FINISH);					// deflate and finish
-			if (nResult != Z_OK && nResult != Z_STREAM_END) {
-				return 1;
+// Returns the length of the compressed block, which is never more than FAST_BOUND(nSrcLen)
+static INT32 FastCompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest)
+{
+	UINT32 HashTable[1 << FAST_HASH_BITS];
+
+	const UINT8* ip = pSrc;
+	const UINT8* pAnchor = pSrc;
+	const UINT8* pEnd = pSrc + nSrcLen;
+	UINT8* op = pDest;
+
+	memset(HashTable, 0, sizeof(HashTable));
+
+	if (nSrcLen > FAST_MF_LIMIT) {
+		const UINT8* pMfLimit = pEnd - FAST_MF_LIMIT;
+		const UINT8* pMatchLimit = pEnd - FAST_LAST_LITERALS;
+
+		while (ip < pMfLimit) {
+			UINT32 nSequence = FastRead32(ip);
+			UINT32 nHash = (nSequence * 2654435761U) >> (32 - FAST_HASH_BITS);
+			const UINT8* pRef = pSrc + HashTable[nHash];
+
+			HashTable[nHash] = ip - pSrc;
+
+			if (pRef >= ip || ip - pRef > FAST_MAX_OFFSET || FastRead32(pRef) != nSequence) {
+				ip += 1 + ((ip - pAnchor) >> 6);				// Skip ahead faster through data that doesn't compress
+				continue;
 			}
-		} else {
-			nResult = deflate(&Zstr, 0);						// deflate
-			if (nResult != Z_OK) {
-				return 1;
+
+			while (ip > pAnchor && pRef > pSrc && ip[-1] == pRef[-1]) {
+				ip--;
+				pRef--;
 			}
-		}
 
-		nCompFill = Zstr.next_out - Comp;						// Update how much has been filled
+			const UINT8* pMatchEnd = ip + FAST_MIN_MATCH;
+			const UINT8* pRefEnd = pRef + FAST_MIN_MATCH;
+			while (pMatchEnd < pMatchLimit && *pMatchEnd == *pRefEnd) {
+				pMatchEnd++;
+				pRefEnd++;
+			}
+
+			UINT8* pToken = op++;
+			INT32 nOffset = ip - pRef;
+			INT32 nMatchLen = pMatchEnd - ip - FAST_MIN_MATCH;
+
+			op = FastPutLiterals(op, pToken, pAnchor, ip - pAnchor);
 
-		// Check for overflow
-		bOverflow = bFinish ? (nResult == Z_OK) : (Zstr.avail_out <= 0);
+			*op++ = nOffset & 0xFF;
+			*op++ = nOffset >> 8;
 
-		if (bOverflow) {
-			if (CompEnlarge(4 * 1024)) {
-				return 1;
+			if (nMatchLen >= 15) {
+				*pToken |= 15;
+				op = FastPutLength(op, nMatchLen - 15);
+			} else {
+				*pToken |= nMatchLen;
 			}
 
-			bRetry = true;
+			ip = pAnchor = pMatchEnd;
 		}
-	} while (bRetry);
+	}
 
-	return 0;
+	UINT8* pToken = op++;
+	op = FastPutLiterals(op, pToken, pAnchor, pEnd - pAnchor);
+
+	return op - pDest;
 }
 
-static INT32 __cdecl StateCompressAcb(struct BurnArea* pba)
+// Add the extra length bytes that follow a 15 in the token. Fails once the length passes nMax, before the
+// sum can overflow, as a run of 255s in a corrupt block would otherwise make it
+static INT32 FastGetLength(const UINT8** pip, const UINT8* pEnd, INT32* pnLen, INT32 nMax)
 {
-	// Set the data as the next available input
-	Zstr.next_in = (UINT8*)pba->Data;
-	Zstr.avail_in = pba->nLen;
-
-	CompGo(0);													// Compress this Area
+	UINT8 n;
 
-	Zstr.avail_in = 0;
-	Zstr.next_in = NULL;
+	do {
+		if (*pip >= pEnd) {
+			return 1;
+		}
+		n = *(*pip)++;
+		*pnLen += n;
+		if (*pnLen > nMax) {
+			return 1;
+		}
+	} while (n == 255);
 
 	return 0;
 }
 
-// Compress a state using deflate
-INT32 BurnStateCompress(UINT8** pDef, INT32* pnDefLen, INT32 bAll)
+// Decompress a block that must expand to exactly nDestLen bytes
+static INT32 FastDecompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest, INT32 nDestLen)
 {
-	void* NewMem = NULL;
+	const UINT8* ip = pSrc;
+	const UINT8* pEnd = pSrc + nSrcLen;
+	UINT8* op = pDest;
+	UINT8* pDestEnd = pDest + nDestLen;
 
-	memset(&Zstr, 0, sizeof(Zstr));
+	while (ip < pEnd) {
+		UINT8 nToken = *ip++;
+		INT32 nLen = nToken >> 4;
 
-	Comp = NULL; nCompLen = 0; nCompFill = 0;					// Begin with a zero-length buffer
-	if (CompEnlarge(8 * 1024)) {
-		return 1;
+		if (nLen == 15 && FastGetLength(&ip, pEnd, &nLen, pDestEnd - op)) {
+			return 1;
+		}
+		if (nLen > pEnd - ip || nLen > pDestEnd - op) {
+			return 1;
+		}
+
+		memcpy(op, ip, nLen);
+		ip += nLen;
+		op += nLen;
+
+		if (ip == pEnd) {												// The last sequence has no match
+			break;
+		}
+
+		if (pEnd - ip < 2) {
+			return 1;
+		}
+		INT32 nOffset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (nOffset == 0 || nOffset > op - pDest) {
+			return 1;
+		}
+
+		nLen = nToken & 15;
+		if (nLen == 15 && FastGetLength(&ip, pEnd, &nLen, (pDestEnd - op) - FAST_MIN_MATCH)) {
+			return 1;
+		}
+		nLen += FAST_MIN_MATCH;
+		if (nLen > pDestEnd - op) {
+			return 1;
+		}
+
+		const UINT8* pRef = op - nOffset;
+		if (nOffset >= nLen) {
+			memcpy(op, pRef, nLen);
+			op += nLen;
+		} else {
+			while (nLen--) {											// Overlapping, repeats the last nOffset bytes
+				*op++ = *pRef++;
+			}
+		}
 	}
 
-	deflateInit(&Zstr, Z_DEFAULT_COMPRESSION);
+	return (op == pDestEnd) ? 0 : 1;
+}
 
-	BurnAcb = StateCompressAcb;									// callback our function with each area
+// The fast codec on its own, for blocks kept in memory. pDest must have room for BurnStateFastBound() bytes
+INT32 BurnStateFastBound(INT32 nSrcLen)
+{
+	return FAST_BOUND(nSrcLen);
+}
 
-	if (bAll) BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);		// scan all ram, read (from driver <- decompress)
-	else      BurnAreaScan(ACB_NVRAM    | ACB_READ, NULL);		// scan nvram,   read (from driver <- decompress)
+INT32 BurnStateFastCompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest)
+{
+	return FastCompress(pSrc, nSrcLen, pDest);
+}
 
-	// Finish off
-	CompGo(1);
+INT32 BurnStateFastDecompress(const UINT8* pSrc, INT32 nSrcLen, UINT8* pDest, INT32 nDestLen)
+{
+	return FastDecompress(pSrc, nSrcLen, pDest, nDestLen);
+}
 
-	deflateEnd(&Zstr);
+// -----------------------------------------------------------------------------
+// Compression
 
-	// Size down
-	NewMem = realloc(Comp, nCompFill);
-	if (NewMem) {
-		Comp = (UINT8*)NewMem;
-		nCompLen = nCompFill;
+// Copy the state out of the driver. The buffer returned must be freed with free()
+INT32 BurnStateSnapshot(UINT8** pRaw, INT32* pnRawLen, INT32 bAll)
+{
+	INT32 nLen = StateRawLen(bAll);
+
+	*pRaw = NULL;
+	*pnRawLen = 0;
+
+	if (nLen <= 0) {
+		return 1;
 	}
 
-	// Return the buffer
-	if (pDef) {
-		*pDef = Comp;
+	StateRaw = (UINT8*)malloc(nLen);
+	if (StateRaw == NULL) {
+		return 1;
 	}
-	if (pnDefLen) {
-		*pnDefLen = nCompFill;
+
+	nStateRawPos = 0;
+
+	BurnAcb = StateRawReadAcb;
+
+	if (bAll) BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);		// scan all ram, read (from driver)
+	else      BurnAreaScan(ACB_NVRAM    | ACB_READ, NULL);		// scan nvram,   read (from driver)
+
+	if (nStateRawPos != nLen) {
+		free(StateRaw);
+		StateRaw = NULL;
+		return 1;
+	}
+
+	*pRaw = StateRaw;
+	*pnRawLen = nLen;
+
+	StateRaw = NULL;
+
+	return 0;
+}
+
+// Compress a snapshot. Doesn't touch the driver, so it's safe to call from any thread
+INT32 BurnStateCompressRaw(const UINT8* Raw, INT32 nRawLen, INT32 nCodec, UINT8** pDef, INT32* pnDefLen)
+{
+	UINT8* Def = NULL;
+	INT32 nDefLen = 0;
+
+	*pDef = NULL;
+	*pnDefLen = 0;
+
+	if (nCodec == BURN_STATE_FAST) {
+		Def = (UINT8*)malloc(FAST_HEADER_LEN + FAST_BOUND(nRawLen));
+		if (Def == NULL) {
+			return 1;
+		}
+
+		FastWrite32LE(Def + 0, nRawLen);
+		FastWrite32LE(Def + 4, crc32(0, Raw, nRawLen));
+
+		nDefLen = FAST_HEADER_LEN + FastCompress(Raw, nRawLen, Def + FAST_HEADER_LEN);
+	} else {
+		z_stream DefZstr;
+
+		memset(&DefZstr, 0, sizeof(DefZstr));
+		if (deflateInit(&DefZstr, Z_DEFAULT_COMPRESSION) != Z_OK) {
+			return 1;
+		}
+
+		nDefLen = deflateBound(&DefZstr, nRawLen);
+		Def = (UINT8*)malloc(nDefLen);
+		if (Def == NULL) {
+			deflateEnd(&DefZstr);
+			return 1;
+		}
+
+		DefZstr.next_in = (Bytef*)Raw;
+		DefZstr.avail_in = nRawLen;
+		DefZstr.next_out = Def;
+		DefZstr.avail_out = nDefLen;
+
+		if (deflate(&DefZstr, Z_FINISH) != Z_STREAM_END) {
+			deflateEnd(&DefZstr);
+			free(Def);
+			return 1;
+		}
+
+		nDefLen = DefZstr.total_out;
+		deflateEnd(&DefZstr);
 	}
 
+	*pDef = Def;
+	*pnDefLen = nDefLen;
+
 	return 0;
 }
 
+// Compress a state
+INT32 BurnStateCompress(UINT8** pDef, INT32* pnDefLen, INT32 bAll, INT32 nCodec)
+{
+	UINT8* Raw = NULL;
+	INT32 nRawLen = 0;
+	INT32 nRet;
+
+	if (BurnStateSnapshot(&Raw, &nRawLen, bAll)) {
+		*pDef = NULL;
+		*pnDefLen = 0;
+		return 1;
+	}
+
+	nRet = BurnStateCompressRaw(Raw, nRawLen, nCodec, pDef, pnDefLen);
+
+	free(Raw);
+
+	return nRet;
+}
+
 // -----------------------------------------------------------------------------
 // Decompression
 
@@ -150,8 +406,48 @@ static INT32 __cdecl StateDecompressAcb(struct BurnArea* pba)
 	return 0;
 }
 
-INT32 BurnStateDecompress(UINT8* Def, INT32 nDefLen, INT32 bAll)
+static INT32 StateDecompressFast(UINT8* Def, INT32 nDefLen, INT32 bAll)
 {
+	INT32 nLen = StateRawLen(bAll);
+
+	if (nDefLen < FAST_HEADER_LEN || nLen <= 0) {
+		return 1;
+	}
+	if (FastRead32LE(Def) != (UINT32)nLen) {					// Not a state of this driver
+		return 1;
+	}
+
+	StateRaw = (UINT8*)malloc(nLen);
+	if (StateRaw == NULL) {
+		return 1;
+	}
+
+	// Only touch the driver once the whole state has been unpacked
+	if (FastDecompress(Def + FAST_HEADER_LEN, nDefLen - FAST_HEADER_LEN, StateRaw, nLen) || crc32(0, StateRaw, nLen) != FastRead32LE(Def + 4)) {
+		free(StateRaw);
+		StateRaw = NULL;
+		return 1;
+	}
+
+	nStateRawPos = 0;
+
+	BurnAcb = StateRawWriteAcb;
+
+	if (bAll) BurnAreaScan(ACB_FULLSCAN | ACB_WRITE, NULL);		// scan all ram, write (to driver <- decompress)
+	else      BurnAreaScan(ACB_NVRAM    | ACB_WRITE, NULL);		// scan nvram,   write (to driver <- decompress)
+
+	free(StateRaw);
+	StateRaw = NULL;
+
+	return 0;
+}
+
+INT32 BurnStateDecompress(UINT8* Def, INT32 nDefLen, INT32 bAll, INT32 nCodec)
+{
+	if (nCodec == BURN_STATE_FAST) {
+		return StateDecompressFast(Def, nDefLen, bAll);
+	}
+
 	memset(&Zstr, 0, sizeof(Zstr));
 	inflateInit(&Zstr);
 
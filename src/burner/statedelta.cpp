@@ -0,0 +1,250 @@
+// Driver State Delta module
+//
+// Keeps a flat copy of the driver state as of the last snapshot. A new
+// snapshot compares the current state with that copy a 4KB page at a time,
+// so taking one every frame costs little more than a memcmp() of the state,
+// and returns what the changed pages held before: an undo record that takes
+// the new snapshot back to the one before it. Undoing the records from the
+// newest down steps the copy back through older and older snapshots, and
+// BurnStateDeltaLoad() then puts the driver in that state. Once the copy has
+// been stepped back, the records that were undone (and any newer ones) no
+// longer apply and must be dropped; the next snapshot carries on from there.
+//
+// A delta holds a DeltaHeader followed, for every changed page, by its index
+// (UINT32) and its old contents. The last page of the state may be shorter.
+// Deltas use the host's byte order and are only meant to be kept in memory.
+//
+// Rollback (rollback.cpp) is the one user. retro_serialize() and frontend
+// run-ahead don't use deltas: the libretro API has the core write a complete
+// state into the frontend's buffer, so run-ahead still costs a full state.
+
+#include "burner.h"
+
+#define DELTA_PAGE_SHIFT	(12)
+#define DELTA_PAGE_SIZE		(1 << DELTA_PAGE_SHIFT)
+
+struct DeltaHeader {
+	char szMagic[4];
+	UINT32 nStateLen;
+	UINT32 nPages;
+};
+
+static UINT8* StateRef = NULL;			// State as of the last snapshot
+static UINT8* PageDirty = NULL;			// Pages changed by the snapshot being taken
+static UINT8* Delta = NULL;				// Delta returned by BurnStateDeltaSave()
+static UINT8* pDeltaPos = NULL;
+static INT32 nStateLen = 0;
+static INT32 nStatePages = 0;
+static INT32 nStatePos = 0;				// Offset of the area being scanned
+static bool bStateOverflow = false;
+
+static inline INT32 DeltaPageLen(INT32 nPage)
+{
+	INT32 nLen = nStateLen - (nPage << DELTA_PAGE_SHIFT);
+
+	return (nLen > DELTA_PAGE_SIZE) ? DELTA_PAGE_SIZE : nLen;
+}
+
+static INT32 __cdecl StateDeltaLenAcb(struct BurnArea* pba)
+{
+	nStateLen += pba->nLen;
+
+	return 0;
+}
+
+// Copy an area into the reference. The first change to a page stores the page as it was in the delta:
+// any part of it scanned before was unchanged, so the reference still holds all of the old page then
+static INT32 __cdecl StateDeltaSaveAcb(struct BurnArea* pba)
+{
+	UINT8* pSrc = (UINT8*)pba->Data;
+	INT32 nLen = pba->nLen;
+
+	if (nStatePos + nLen > nStateLen) {
+		bStateOverflow = true;
+		return 0;
+	}
+
+	while (nLen > 0) {
+		INT32 nPage = nStatePos >> DELTA_PAGE_SHIFT;
+		INT32 nChunk = DELTA_PAGE_SIZE - (nStatePos & (DELTA_PAGE_SIZE - 1));
+		if (nChunk > nLen) {
+			nChunk = nLen;
+		}
+
+		if (memcmp(StateRef + nStatePos, pSrc, nChunk)) {
+			if (PageDirty[nPage] == 0) {
+				INT32 nPageLen = DeltaPageLen(nPage);
+
+				memcpy(pDeltaPos, &nPage, sizeof(UINT32));
+				memcpy(pDeltaPos + sizeof(UINT32), StateRef + (nPage << DELTA_PAGE_SHIFT), nPageLen);
+				pDeltaPos += sizeof(UINT32) + nPageLen;
+				PageDirty[nPage] = 1;
+			}
+			memcpy(StateRef + nStatePos, pSrc, nChunk);
+		}
+
+		pSrc += nChunk;
+		nStatePos += nChunk;
+		nLen -= nChunk;
+	}
+
+	return 0;
+}
+
+static INT32 __cdecl StateDeltaLoadAcb(struct BurnArea* pba)
+{
+	if (nStatePos + (INT32)pba->nLen > nStateLen) {
+		bStateOverflow = true;
+		return 0;
+	}
+
+	memcpy(pba->Data, StateRef + nStatePos, pba->nLen);
+	nStatePos += pba->nLen;
+
+	return 0;
+}
+
+void BurnStateDeltaExit()
+{
+	if (StateRef) {
+		free(StateRef);
+		StateRef = NULL;
+	}
+	if (PageDirty) {
+		free(PageDirty);
+		PageDirty = NULL;
+	}
+	if (Delta) {
+		free(Delta);
+		Delta = NULL;
+	}
+
+	nStateLen = 0;
+	nStatePages = 0;
+}
+
+// Size the buffers for the running driver and take the first snapshot
+INT32 BurnStateDeltaInit()
+{
+	BurnStateDeltaExit();
+
+	BurnAcb = StateDeltaLenAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+
+	if (nStateLen <= 0) {
+		return 1;
+	}
+
+	nStatePages = (nStateLen + DELTA_PAGE_SIZE - 1) >> DELTA_PAGE_SHIFT;
+
+	StateRef = (UINT8*)calloc(1, nStateLen);
+	PageDirty = (UINT8*)calloc(1, nStatePages);
+	Delta = (UINT8*)malloc(sizeof(DeltaHeader) + nStatePages * (sizeof(UINT32) + DELTA_PAGE_SIZE));
+	if (StateRef == NULL || PageDirty == NULL || Delta == NULL) {
+		BurnStateDeltaExit();
+		return 1;
+	}
+
+	return BurnStateDeltaSave(NULL, NULL);
+}
+
+// Take a snapshot. *pDelta points to the undo record back to the snapshot before, and stays valid until the
+// next call. If this fails the snapshot is incomplete and BurnStateDeltaInit() has to be called again
+INT32 BurnStateDeltaSave(UINT8** pDelta, INT32* pnDeltaLen)
+{
+	DeltaHeader* pHeader = (DeltaHeader*)Delta;
+
+	if (StateRef == NULL) {
+		return 1;
+	}
+
+	memset(PageDirty, 0, nStatePages);
+	pDeltaPos = Delta + sizeof(DeltaHeader);
+
+	nStatePos = 0;
+	bStateOverflow = false;
+
+	BurnAcb = StateDeltaSaveAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+
+	if (bStateOverflow || nStatePos != nStateLen) {
+		return 1;
+	}
+
+	memcpy(pHeader->szMagic, "FBDS", 4);
+	pHeader->nStateLen = nStateLen;
+	pHeader->nPages = 0;
+	for (INT32 i = 0; i < nStatePages; i++) {
+		pHeader->nPages += PageDirty[i];
+	}
+
+	if (pDelta) {
+		*pDelta = Delta;
+	}
+	if (pnDeltaLen) {
+		*pnDeltaLen = pDeltaPos - Delta;
+	}
+
+	return 0;
+}
+
+// Step the last snapshot back by one undo record, newest first. The driver is left alone
+INT32 BurnStateDeltaUndo(const UINT8* pDelta, INT32 nDeltaLen)
+{
+	DeltaHeader Header;
+
+	if (StateRef == NULL || pDelta == NULL || nDeltaLen < (INT32)sizeof(DeltaHeader)) {
+		return 1;
+	}
+
+	memcpy(&Header, pDelta, sizeof(DeltaHeader));
+	if (memcmp(Header.szMagic, "FBDS", 4) || Header.nStateLen != (UINT32)nStateLen) {
+		return 1;
+	}
+
+	// Check the whole delta before the first page is patched in
+	for (INT32 nPass = 0; nPass < 2; nPass++) {
+		const UINT8* pSrc = pDelta + sizeof(DeltaHeader);
+		const UINT8* pEnd = pDelta + nDeltaLen;
+
+		for (UINT32 i = 0; i < Header.nPages; i++) {
+			UINT32 nPage;
+
+			if (pEnd - pSrc < (INT32)sizeof(UINT32)) {
+				return 1;
+			}
+			memcpy(&nPage, pSrc, sizeof(UINT32));
+			if (nPage >= (UINT32)nStatePages) {
+				return 1;
+			}
+
+			INT32 nLen = DeltaPageLen(nPage);
+			if (pEnd - pSrc < (INT32)sizeof(UINT32) + nLen) {
+				return 1;
+			}
+
+			if (nPass) {
+				memcpy(StateRef + (nPage << DELTA_PAGE_SHIFT), pSrc + sizeof(UINT32), nLen);
+			}
+			pSrc += sizeof(UINT32) + nLen;
+		}
+	}
+
+	return 0;
+}
+
+// Put the driver in the state of the last snapshot (as stepped back by BurnStateDeltaUndo())
+INT32 BurnStateDeltaLoad()
+{
+	if (StateRef == NULL) {
+		return 1;
+	}
+
+	nStatePos = 0;
+	bStateOverflow = false;
+
+	BurnAcb = StateDeltaLoadAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_WRITE, NULL);
+
+	return bStateOverflow ? 1 : 0;
+}
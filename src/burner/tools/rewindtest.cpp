@@ -0,0 +1,210 @@
+// rewindtest - consistency test for the rewind buffer (rewind.cpp)
+//
+// Drives BurnRewindPush() and BurnRewindStep() with a made-up driver whose
+// state changes by very different amounts from frame to frame: not at all, a
+// few bytes, a run of noise, a long run of one value, or a whole area. The
+// compressed deltas so vary from a few bytes to nearly the size of the state,
+// and with a small buffer they wrap around it many times. Every so often the
+// test steps back a random number of frames, checks the CRC32 of the state
+// after each step against the one that frame had when it was pushed, and
+// carries on from there. At the end it steps back as far as the buffer goes.
+//
+// usage: rewindtest [options]
+//   -n frames      frames to push (default 5000)
+//   -k kb          size of the rewind buffer (default 4096)
+//   -s seed        seed for the changes and the step backs (default 1)
+//
+// The exit code is 0 if every step back came out right, 1 if one didn't and
+// 2 on errors.
+
+#include <stdio.h>
+#include "zlib.h"
+#include "burner.h"
+
+// ----------------------------------------------------------------------------
+// The parts of the emulator the rewind buffer needs
+
+#define TEST_AREAS	(3)
+
+static const INT32 nAreaLen[TEST_AREAS] = { 0x10000, 0x31234, 7 };
+static UINT8* Area[TEST_AREAS];
+
+static INT32 __cdecl TestAcb(struct BurnArea*) { return 0; }
+INT32 (__cdecl *BurnAcb) (struct BurnArea* pba) = TestAcb;
+
+INT32 BurnAreaScan(INT32, INT32*)
+{
+	struct BurnArea ba;
+
+	for (INT32 i = 0; i < TEST_AREAS; i++) {
+		memset(&ba, 0, sizeof(ba));
+		ba.Data = Area[i];
+		ba.nLen = nAreaLen[i];
+		ba.szName = "Test area";
+		BurnAcb(&ba);
+	}
+
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+static UINT32 nRandom = 1;
+
+static UINT32 Random()
+{
+	nRandom ^= nRandom << 13;
+	nRandom ^= nRandom >> 17;
+	nRandom ^= nRandom << 5;
+
+	return nRandom;
+}
+
+static UINT32 StateCrc()
+{
+	UINT32 nCrc = crc32(0, NULL, 0);
+
+	for (INT32 i = 0; i < TEST_AREAS; i++) {
+		nCrc = crc32(nCrc, Area[i], nAreaLen[i]);
+	}
+
+	return nCrc;
+}
+
+// Change the state the way a frame might, by a random amount
+static void RunFrame()
+{
+	INT32 a = Random() % TEST_AREAS;
+	INT32 nLen, nPos;
+
+	switch (Random() % 8) {
+		case 0:											// Nothing changes
+			break;
+		case 1:
+		case 2:
+		case 3:											// A few bytes
+			for (INT32 i = Random() % 16 + 1; i > 0; i--) {
+				Area[a][Random() % nAreaLen[a]] = Random();
+			}
+			break;
+		case 4:
+		case 5:											// A run of noise
+			nLen = Random() % 0x1000 + 1;
+			nPos = Random() % nAreaLen[a];
+			for (INT32 i = 0; i < nLen && nPos + i < nAreaLen[a]; i++) {
+				Area[a][nPos + i] = Random();
+			}
+			break;
+		case 6:											// A long run of one value
+			nLen = Random() % 0x10000 + 1;
+			nPos = Random() % nAreaLen[a];
+			if (nLen > nAreaLen[a] - nPos) {
+				nLen = nAreaLen[a] - nPos;
+			}
+			memset(Area[a] + nPos, Random(), nLen);
+			break;
+		case 7:											// The whole area
+			for (INT32 i = 0; i < nAreaLen[a]; i++) {
+				Area[a][i] = Random();
+			}
+			break;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	INT32 nFrames = 5000;
+	INT32 nBudget = 4096;
+	INT32 i;
+
+	for (i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		if (!strcmp(argv[i], "-n")) {
+			nFrames = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "-k")) {
+			nBudget = atoi(argv[i + 1]);
+		} else if (!strcmp(argv[i], "-s")) {
+			nRandom = strtoul(argv[i + 1], NULL, 10);
+		} else {
+			break;
+		}
+	}
+	if (i != argc || nFrames < 1 || nBudget < 1 || nRandom == 0) {
+		fprintf(stderr, "usage: rewindtest [-n frames] [-k kb] [-s seed]\n");
+		return 2;
+	}
+
+	UINT32* FrameCrc = (UINT32*)malloc(nFrames * sizeof(UINT32));
+	if (FrameCrc == NULL) {
+		return 2;
+	}
+	for (i = 0; i < TEST_AREAS; i++) {
+		Area[i] = (UINT8*)calloc(1, nAreaLen[i]);
+		if (Area[i] == NULL) {
+			return 2;
+		}
+	}
+
+	if (BurnRewindInit(nBudget << 10)) {
+		fprintf(stderr, "can't allocate a rewind buffer of %d KB\n", nBudget);
+		return 2;
+	}
+
+	INT32 nRet = 0;
+	INT32 nPushed = 0, nSteps = 0, nMostFrames = 0;
+	INT32 nFrame = 0;
+
+	while (nFrame < nFrames && nRet == 0) {
+		RunFrame();
+		FrameCrc[nFrame] = StateCrc();
+		BurnRewindPush();
+		nPushed++;
+
+		if (BurnRewindFrames() > nMostFrames) {
+			nMostFrames = BurnRewindFrames();
+		}
+
+		// Step back through the frames, newest first, or as far as the buffer goes at the end
+		bool bLast = nFrame == nFrames - 1;
+		INT32 nBack = 0;
+		if (bLast) {
+			nBack = BurnRewindFrames();
+		} else if (Random() % 64 == 0) {
+			nBack = Random() % 32 + 1;
+		}
+
+		for (; nBack > 0 && BurnRewindFrames() > 0; nBack--) {
+			if (BurnRewindStep()) {
+				printf("step back from frame %d failed\n", nFrame);
+				nRet = 1;
+				break;
+			}
+			nFrame--;
+			nSteps++;
+
+			UINT32 nCrc = StateCrc();
+			if (nCrc != FrameCrc[nFrame]) {
+				printf("stepped back to frame %d wrongly (crc %08x, was %08x)\n", nFrame, nCrc, FrameCrc[nFrame]);
+				nRet = 1;
+				break;
+			}
+		}
+
+		if (bLast) {
+			break;
+		}
+		nFrame++;
+	}
+
+	printf("%d frames pushed, %d stepped back, up to %d frames held\n", nPushed, nSteps, nMostFrames);
+	if (nRet == 0) {
+		printf("every step back matched\n");
+	}
+
+	BurnRewindExit();
+	for (i = 0; i < TEST_AREAS; i++) {
+		free(Area[i]);
+	}
+	free(FrameCrc);
+
+	return nRet;
+}
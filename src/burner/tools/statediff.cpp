@@ -0,0 +1,613 @@
+// statediff - determinism checker for the driver state
+//
+// Loads a game through the libretro interface with no frontend attached,
+// plays an input log through retro_run() (and so BurnDrvFrame()) and every
+// N frames writes the CRC32 of each area BurnAreaScan() reports, by index
+// and name ("68K RAM", "Memory card", ...). Given the dump of an earlier run
+// it stops at the first area that differs and reports its frame and name, so
+// a CPU core or scheduling change can be checked to leave the emulation
+// exactly as it was.
+//
+// usage: statediff [options] game.zip
+//   -i log         input log (default: no buttons pressed)
+//   -m movie       play an input movie (see movie.cpp) instead. Implies -r,
+//                  as the core stops movies on frames it isn't to show
+//   -p ports       ports per frame in the input log (default 2)
+//   -n frames      frames to run (default: the length of the log or the
+//                  movie, or 3600)
+//   -e frames      hash the state every this many frames (default 60)
+//   -o file        write the hashes to this file
+//   -c file        compare with the hashes of an earlier run
+//   -s dir         system directory holding the BIOS (default: the game's)
+//   -O key=value   set a core option, e.g. -O fba-neogeo_mode=AES
+//   -r             render video and sound too (default: neither, as for
+//                  run-ahead frames, which doesn't change the emulation)
+//   -b frames      check rollback: every -e frames, go back this many frames
+//                  with BurnRollbackLoad(), resimulate them with
+//                  BurnRollbackRun() and the inputs they were played with,
+//                  and compare BurnRollbackChecksum() after each with the
+//                  checksum the frame had when it was played
+//
+//        statediff -d file file
+//                  compare two dumps written earlier
+//
+// The input log holds, for every frame, one little endian UINT16 per port
+// with bit n set while RETRO_DEVICE_ID_JOYPAD_n is held. Each dump line is
+// "frame area crc32 length name". The exit code is 0 if the runs match, 1 if
+// they diverge and 2 on errors. A temporary save directory is used, so the
+// state the core saves on exit is never loaded back into a later run, and the
+// real-time clocks are started at the same time (STATEDIFF_CLOCK) every run.
+//
+// The speed the frames ran at is reported as well. Without -o or -c no
+// hashes are taken, so playing a movie makes a benchmark of real gameplay.
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "zlib.h"
+#include "burner.h"
+#include "libretro.h"
+
+// ----------------------------------------------------------------------------
+// Frontend
+
+#define MAX_OPTIONS	(32)
+
+#define STATEDIFF_CLOCK	(946684800)		// 2000-01-01 00:00:00 UTC
+
+static const char* szOptionKey[MAX_OPTIONS];
+static const char* szOptionValue[MAX_OPTIONS];
+static INT32 nOptions = 0;
+
+static char szSaveDir[64] = "/tmp/statediffXXXXXX";
+static const char* szSystemDir = NULL;
+static bool bRender = false;
+
+static UINT8* InputLog = NULL;
+static INT32 nInputFrames = 0;
+static INT32 nInputPorts = 2;
+static INT32 nInputFrame = 0;
+
+static void LogCallback(enum retro_log_level nLevel, const char* szFormat, ...)
+{
+	va_list vl;
+
+	if (nLevel < RETRO_LOG_WARN) {
+		return;
+	}
+
+	va_start(vl, szFormat);
+	vfprintf(stderr, szFormat, vl);
+	va_end(vl);
+}
+
+static bool EnvironmentCallback(unsigned nCmd, void* pData)
+{
+	switch (nCmd) {
+		case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+			((struct retro_log_callback*)pData)->log = LogCallback;
+			return true;
+
+		case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+			*(const char**)pData = szSaveDir;
+			return true;
+
+		case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+			*(const char**)pData = szSystemDir;
+			return szSystemDir != NULL;
+
+		case RETRO_ENVIRONMENT_GET_VARIABLE: {
+			struct retro_variable* pVar = (struct retro_variable*)pData;
+			for (INT32 i = 0; i < nOptions; i++) {
+				if (strcmp(pVar->key, szOptionKey[i]) == 0) {
+					pVar->value = szOptionValue[i];
+					return true;
+				}
+			}
+			return false;
+		}
+
+		case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE:
+			*(int*)pData = bRender ? 3 : 0;
+			return true;
+
+		case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+			return true;
+	}
+
+	return false;
+}
+
+static void VideoCallback(const void*, unsigned, unsigned, size_t) { }
+static size_t AudioCallback(const int16_t*, size_t nFrames) { return nFrames; }
+static void InputPollCallback() { }
+
+static int16_t InputStateCallback(unsigned nPort, unsigned nDevice, unsigned, unsigned nId)
+{
+	if (nDevice != RETRO_DEVICE_JOYPAD || (INT32)nPort >= nInputPorts || nInputFrame >= nInputFrames) {
+		return 0;
+	}
+
+	const UINT8* p = InputLog + (nInputFrame * nInputPorts + nPort) * 2;
+	UINT32 nMask = p[0] | (p[1] << 8);
+
+	if (nId == RETRO_DEVICE_ID_JOYPAD_MASK) {
+		return nMask;
+	}
+
+	return (nId < 16) ? ((nMask >> nId) & 1) : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Hashes
+
+struct AreaHash {
+	INT32 nFrame;
+	INT32 nArea;
+	UINT32 nCrc;
+	UINT32 nLen;
+	char szName[64];
+};
+
+static FILE* fDump = NULL;
+static FILE* fRef = NULL;
+static INT32 nFrame = 0;
+static INT32 nArea = 0;
+static bool bDiverged = false;
+
+static INT32 ReadHash(FILE* f, AreaHash* pHash)
+{
+	char szLine[256];
+
+	if (fgets(szLine, sizeof(szLine), f) == NULL) {
+		return 1;
+	}
+
+	pHash->szName[0] = '\0';
+	if (sscanf(szLine, "%d %d %x %u %63[^\n]", &pHash->nFrame, &pHash->nArea, &pHash->nCrc, &pHash->nLen, pHash->szName) < 4) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static void PrintHash(FILE* f, const AreaHash* pHash)
+{
+	fprintf(f, "%d %d %08x %u %s\n", pHash->nFrame, pHash->nArea, pHash->nCrc, pHash->nLen, pHash->szName);
+}
+
+// Returns 1 (and reports where) if the hashes are of different states
+static INT32 CompareHash(const AreaHash* pHash, const AreaHash* pRef)
+{
+	if (pHash->nFrame == pRef->nFrame && pHash->nArea == pRef->nArea && pHash->nCrc == pRef->nCrc && pHash->nLen == pRef->nLen && strcmp(pHash->szName, pRef->szName) == 0) {
+		return 0;
+	}
+
+	if (pHash->nFrame != pRef->nFrame || pHash->nArea != pRef->nArea) {
+		printf("diverged at frame %d: the states have different areas\n", pRef->nFrame < pHash->nFrame ? pRef->nFrame : pHash->nFrame);
+	} else {
+		printf("diverged at frame %d, area %d \"%s\"", pRef->nFrame, pRef->nArea, pRef->szName);
+		if (pHash->nLen != pRef->nLen || strcmp(pHash->szName, pRef->szName)) {
+			printf(" (now %u bytes, \"%s\", was %u bytes)", pHash->nLen, pHash->szName, pRef->nLen);
+		}
+		printf("\n");
+	}
+
+	return 1;
+}
+
+static INT32 __cdecl HashAcb(struct BurnArea* pba)
+{
+	AreaHash Hash;
+
+	Hash.nFrame = nFrame;
+	Hash.nArea = nArea++;
+	Hash.nCrc = crc32(0, (const Bytef*)pba->Data, pba->nLen);
+	Hash.nLen = pba->nLen;
+	snprintf(Hash.szName, sizeof(Hash.szName), "%s", pba->szName ? pba->szName : "");
+
+	if (fDump) {
+		PrintHash(fDump, &Hash);
+	}
+
+	if (fRef && !bDiverged) {
+		AreaHash Ref;
+
+		if (ReadHash(fRef, &Ref)) {
+			printf("diverged at frame %d: the earlier run has no more hashes\n", nFrame);
+			bDiverged = true;
+		} else {
+			bDiverged = CompareHash(&Hash, &Ref) != 0;
+		}
+	}
+
+	return 0;
+}
+
+static void HashState()
+{
+	nArea = 0;
+
+	BurnAcb = HashAcb;
+	BurnAreaScan(ACB_FULLSCAN | ACB_READ, NULL);
+}
+
+static INT32 CompareDumps(const char* szFile1, const char* szFile2)
+{
+	FILE* f1 = fopen(szFile1, "r");
+	FILE* f2 = fopen(szFile2, "r");
+	INT32 nRet = 0;
+
+	if (f1 == NULL || f2 == NULL) {
+		fprintf(stderr, "can't open %s\n", f1 ? szFile2 : szFile1);
+		nRet = 2;
+	} else {
+		AreaHash Hash1, Hash2;
+		INT32 nLines = 0;
+
+		while (1) {
+			INT32 nEnd1 = ReadHash(f1, &Hash1);
+			INT32 nEnd2 = ReadHash(f2, &Hash2);
+
+			if (nEnd1 || nEnd2) {
+				if (nEnd1 != nEnd2) {
+					printf("diverged at frame %d: %s has no hashes for it\n", nEnd1 ? Hash2.nFrame : Hash1.nFrame, nEnd1 ? szFile1 : szFile2);
+					nRet = 1;
+				}
+				break;
+			}
+			if (CompareHash(&Hash2, &Hash1)) {
+				nRet = 1;
+				break;
+			}
+			nLines++;
+		}
+
+		if (nRet == 0) {
+			printf("identical, %d area hashes\n", nLines);
+		}
+	}
+
+	if (f1) fclose(f1);
+	if (f2) fclose(f2);
+
+	return nRet;
+}
+
+// ----------------------------------------------------------------------------
+// Rollback check
+
+static INT32 nRollback = 0;				// Frames to go back (0 = no check)
+static INT32 nRollbackRing = 0;
+static UINT32* RollbackCrc = NULL;			// Checksum each frame had when played
+static UINT16* RollbackValues = NULL;		// Driver inputs each frame was played with
+
+static struct BurnInputInfo* RollbackInputs = NULL;
+static INT32 nRollbackInputs = 0;
+
+static inline bool RollbackInputIsAnalog(INT32 i)
+{
+	return (RollbackInputs[i].nType & BIT_GROUP_ANALOG) && !(RollbackInputs[i].nType & BIT_GROUP_CONSTANT);
+}
+
+static INT32 RollbackCheckInit()
+{
+	struct BurnInputInfo bii;
+
+	for (nRollbackInputs = 0; BurnDrvGetInputInfo(&bii, nRollbackInputs) == 0; nRollbackInputs++) {
+	}
+
+	nRollbackRing = nRollback + 1;
+
+	RollbackInputs = (struct BurnInputInfo*)malloc((nRollbackInputs + 1) * sizeof(struct BurnInputInfo));
+	RollbackValues = (UINT16*)calloc(nRollbackRing * (nRollbackInputs + 1), sizeof(UINT16));
+	RollbackCrc = (UINT32*)calloc(nRollbackRing, sizeof(UINT32));
+	if (RollbackInputs == NULL || RollbackValues == NULL || RollbackCrc == NULL) {
+		return 1;
+	}
+
+	for (INT32 i = 0; i < nRollbackInputs; i++) {
+		BurnDrvGetInputInfo(&RollbackInputs[i], i);
+	}
+
+	return BurnRollbackInit(nRollbackRing);
+}
+
+static void RollbackCheckExit()
+{
+	BurnRollbackExit();
+
+	free(RollbackInputs);
+	free(RollbackValues);
+	free(RollbackCrc);
+}
+
+// Keep the inputs frame nFrame was played with, and save it
+static void RollbackCheckSave(INT32 nFrame)
+{
+	UINT16* pValues = RollbackValues + (nFrame % nRollbackRing) * (nRollbackInputs + 1);
+
+	for (INT32 i = 0; i < nRollbackInputs; i++) {
+		if (RollbackInputs[i].pVal) {
+			pValues[i] = RollbackInputIsAnalog(i) ? *RollbackInputs[i].pShortVal : *RollbackInputs[i].pVal;
+		}
+	}
+
+	RollbackCrc[nFrame % nRollbackRing] = BurnRollbackChecksum();
+	BurnRollbackSave(nFrame);
+}
+
+static void RollbackCheckSetInputs(INT32 nFrame)
+{
+	const UINT16* pValues = RollbackValues + (nFrame % nRollbackRing) * (nRollbackInputs + 1);
+
+	for (INT32 i = 0; i < nRollbackInputs; i++) {
+		if (RollbackInputs[i].pVal) {
+			if (RollbackInputIsAnalog(i)) {
+				*RollbackInputs[i].pShortVal = pValues[i];
+			} else {
+				*RollbackInputs[i].pVal = (UINT8)pValues[i];
+			}
+		}
+	}
+}
+
+// Go back from frame nFrame and resimulate up to it again, one frame at a time so the first frame that
+// comes out differently is the one reported. Returns 1 if one did
+static INT32 RollbackCheck(INT32 nFrame)
+{
+	INT32 nFrom = nFrame - nRollback;
+	if (nFrom < 0) {
+		nFrom = 0;
+	}
+	if (nFrom == nFrame) {
+		return 0;
+	}
+
+	if (BurnRollbackLoad(nFrom)) {
+		printf("rollback to frame %d failed\n", nFrom);
+		return 1;
+	}
+
+	for (INT32 f = nFrom + 1; f <= nFrame; f++) {
+		RollbackCheckSetInputs(f);
+		BurnRollbackRun(1, NULL);
+
+		UINT32 nCrc = BurnRollbackChecksum();
+		if (nCrc != RollbackCrc[f % nRollbackRing]) {
+			printf("diverged at frame %d when resimulated from frame %d (checksum %08x, was %08x)\n", f, nFrom, nCrc, RollbackCrc[f % nRollbackRing]);
+			return 1;
+		}
+
+		BurnRollbackSave(f);
+	}
+
+	return 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// Throw away the save directory and whatever the core left in it
+static void RemoveSaveDir()
+{
+	DIR* pDir = opendir(szSaveDir);
+
+	if (pDir) {
+		struct dirent* pEntry;
+		char szFile[256];
+
+		while ((pEntry = readdir(pDir)) != NULL) {
+			if (strcmp(pEntry->d_name, ".") && strcmp(pEntry->d_name, "..")) {
+				if (snprintf(szFile, sizeof(szFile), "%s/%s", szSaveDir, pEntry->d_name) < (INT32)sizeof(szFile)) {
+					remove(szFile);
+				}
+			}
+		}
+		closedir(pDir);
+	}
+
+	rmdir(szSaveDir);
+}
+
+static INT32 LoadInputLog(const char* szFile)
+{
+	FILE* f = fopen(szFile, "rb");
+	if (f == NULL) {
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	INT32 nLen = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	InputLog = (UINT8*)malloc(nLen + 1);
+	if (InputLog == NULL || (INT32)fread(InputLog, 1, nLen, f) != nLen) {
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	nInputFrames = nLen / (nInputPorts * 2);
+
+	return 0;
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: statediff [-i log | -m movie] [-p ports] [-n frames] [-e frames] [-o file] [-c file]\n");
+	fprintf(stderr, "                 [-s dir] [-O key=value] [-r] [-b frames] game.zip\n");
+	fprintf(stderr, "       statediff -d file file\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* szInputLog = NULL;
+	const char* szMovie = NULL;
+	const char* szDump = NULL;
+	const char* szRef = NULL;
+	INT32 nFrames = -1;
+	INT32 nEvery = 60;
+	INT32 nArg;
+
+	for (nArg = 1; nArg < argc && argv[nArg][0] == '-'; nArg++) {
+		char c = argv[nArg][1];
+
+		if (c == 'r') {
+			bRender = true;
+			continue;
+		}
+		if (nArg + 1 >= argc) {
+			Usage();
+			return 2;
+		}
+
+		const char* szValue = argv[++nArg];
+		switch (c) {
+			case 'd':
+				if (nArg + 1 >= argc) {
+					Usage();
+					return 2;
+				}
+				return CompareDumps(szValue, argv[nArg + 1]);
+			case 'i': szInputLog = szValue; break;
+			case 'm': szMovie = szValue; bRender = true; break;
+			case 'p': nInputPorts = atoi(szValue); break;
+			case 'n': nFrames = atoi(szValue); break;
+			case 'e': nEvery = atoi(szValue); break;
+			case 'o': szDump = szValue; break;
+			case 'c': szRef = szValue; break;
+			case 's': szSystemDir = szValue; break;
+			case 'b': nRollback = atoi(szValue); break;
+			case 'O': {
+				char* szEquals = strchr((char*)szValue, '=');
+				if (szEquals == NULL || nOptions >= MAX_OPTIONS) {
+					Usage();
+					return 2;
+				}
+				*szEquals = '\0';
+				szOptionKey[nOptions] = szValue;
+				szOptionValue[nOptions++] = szEquals + 1;
+				break;
+			}
+			default:
+				Usage();
+				return 2;
+		}
+	}
+
+	if (nArg != argc - 1 || nInputPorts < 1 || nEvery < 1 || nRollback < 0) {
+		Usage();
+		return 2;
+	}
+
+	if (szInputLog && LoadInputLog(szInputLog)) {
+		fprintf(stderr, "can't load %s\n", szInputLog);
+		return 2;
+	}
+	if (nFrames < 0 && !szMovie) {
+		nFrames = szInputLog ? nInputFrames : 3600;
+	}
+
+	if (szDump && (fDump = fopen(szDump, "w")) == NULL) {
+		fprintf(stderr, "can't create %s\n", szDump);
+		return 2;
+	}
+	if (szRef && (fRef = fopen(szRef, "r")) == NULL) {
+		fprintf(stderr, "can't open %s\n", szRef);
+		return 2;
+	}
+	if (mkdtemp(szSaveDir) == NULL) {
+		fprintf(stderr, "can't create a save directory\n");
+		return 2;
+	}
+
+	retro_set_environment(EnvironmentCallback);
+	retro_set_video_refresh(VideoCallback);
+	retro_set_audio_sample_batch(AudioCallback);
+	retro_set_input_poll(InputPollCallback);
+	retro_set_input_state(InputStateCallback);
+	retro_init();
+
+	// The Neo Geo's calendar chip is saved with the state, so it mustn't start at the host's time
+	nBurnClockTime = STATEDIFF_CLOCK;
+
+	struct retro_game_info Info;
+	memset(&Info, 0, sizeof(Info));
+	Info.path = argv[nArg];
+
+	INT32 nRet = 0;
+	if (!retro_load_game(&Info)) {
+		fprintf(stderr, "can't load %s\n", argv[nArg]);
+		nRet = 2;
+	} else if (szMovie && BurnMoviePlay((TCHAR*)szMovie)) {
+		fprintf(stderr, "can't play %s\n", szMovie);
+		nRet = 2;
+		retro_unload_game();
+	} else if (nRollback && RollbackCheckInit()) {
+		fprintf(stderr, "can't allocate the rollback buffers\n");
+		nRet = 2;
+		RollbackCheckExit();
+		retro_unload_game();
+	} else {
+		if (szMovie) {
+			INT32 nMovieFrames;
+			BurnMovieGetFrames(NULL, &nMovieFrames);
+			if (nFrames < 0 || nFrames > nMovieFrames) {
+				nFrames = nMovieFrames;
+			}
+		}
+
+		clock_t nStart = clock();
+		for (nFrame = 0; nFrame < nFrames && !bDiverged; nFrame++) {
+			nInputFrame = nFrame;
+			retro_run();
+
+			bool bCheck = (nFrame + 1) % nEvery == 0 || nFrame == nFrames - 1;
+			if (nRollback) {
+				RollbackCheckSave(nFrame);
+				if (bCheck && RollbackCheck(nFrame)) {
+					bDiverged = true;
+				}
+			}
+			if ((fDump || fRef) && bCheck) {
+				HashState();
+			}
+		}
+		double dSeconds = (double)(clock() - nStart) / CLOCKS_PER_SEC;
+
+		printf("%d frames in %.2f s", nFrame, dSeconds);
+		if (dSeconds > 0.0) {
+			printf(" (%.1f fps)", nFrame / dSeconds);
+		}
+		printf("\n");
+
+		if (bDiverged) {
+			nRet = 1;
+		} else if (fRef || nRollback) {
+			AreaHash Ref;
+			if (fRef && ReadHash(fRef, &Ref) == 0) {
+				printf("diverged after frame %d: the earlier run has more hashes\n", nFrames - 1);
+				nRet = 1;
+			} else {
+				printf("identical over %d frames\n", nFrames);
+			}
+		}
+
+		if (nRollback) {
+			RollbackCheckExit();
+		}
+		retro_unload_game();
+	}
+
+	// retro_deinit() saves the state into the save directory, which is then thrown away
+	retro_deinit();
+	RemoveSaveDir();
+
+	if (fDump) fclose(fDump);
+	if (fRef) fclose(fRef);
+	free(InputLog);
+
+	return nRet;
+}
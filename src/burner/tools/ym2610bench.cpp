@@ -0,0 +1,377 @@
+// ym2610bench - YM2610 sound stack throughput and regression benchmark
+//
+// Replays a register write trace (captured with a core built with
+// BURN_YM2610_TRACE=1, see burn_ym2610.h) through BurnYM2610Write() and
+// renders it at one or more sample rates. For every rate it reports the
+// throughput of BurnYM2610Update() and a hash of the rendered output, which
+// must not change when optimising the sound cores.
+//
+// With -c the FM (YM2610UpdateOne) and SSG (AY8910Update) cores are also
+// timed on their own. Writes are then applied at the start of each frame,
+// so that pass has its own hash, taken over the output of both cores.
+//
+// usage: ym2610bench [options] trace vrom [vrom...]
+//   -r rate[,rate...]  sample rates (default 22050,44100,48000)
+//   -s seconds         emulated time to render per rate (default 60)
+//   -i interpolation   nFMInterpolation, 0 or 3 (default 0)
+//   -b vrom            separate ADPCM-B ROM (default: same as ADPCM-A)
+//   -c                 also time the chip cores in isolation
+//
+// The V-ROMs are loaded in order as one ADPCM-A image. They must be plain
+// (decrypted) dumps; the M1 ROM isn't needed since its writes are in the trace.
+
+#include <stdio.h>
+#include <time.h>
+#include "burnint.h"
+#include "burn_sound.h"
+#include "burn_ym2610.h"
+
+// ----------------------------------------------------------------------------
+// The parts of the emulator the sound stack needs
+
+INT32 nBurnFPS = 6000;
+INT32 nBurnSoundRate = 0;
+INT32 nBurnSoundLen = 0;
+INT32 nFMInterpolation = 0;
+bool bBurnNoRender = false;
+double dTime;
+
+static INT32 __cdecl BenchAcb(struct BurnArea*) { return 0; }
+INT32 (__cdecl *BurnAcb) (struct BurnArea* pba) = BenchAcb;
+
+extern "C" {
+	void state_save_register_func_postload(void (*)()) { }
+	void state_save_register_INT8(const char*, INT32, const char*, INT8*, unsigned) { }
+	void state_save_register_UINT8(const char*, INT32, const char*, UINT8*, unsigned) { }
+	void state_save_register_INT16(const char*, INT32, const char*, INT16*, unsigned) { }
+	void state_save_register_UINT16(const char*, INT32, const char*, UINT16*, unsigned) { }
+	void state_save_register_INT32(const char*, INT32, const char*, INT32*, unsigned) { }
+	void state_save_register_UINT32(const char*, INT32, const char*, UINT32*, unsigned) { }
+	void state_save_register_int(const char*, INT32, const char*, INT32*) { }
+	void state_save_register_float(const char*, INT32, const char*, float*, unsigned) { }
+	void state_save_register_double(const char*, INT32, const char*, double*, unsigned) { }
+
+	double BurnTimerGetTime() { return dTime; }
+}
+
+// The YM2610 timers drive the Z80 IRQ, which isn't emulated here
+void BurnOPNTimerCallback(INT32, INT32, INT32, double) { }
+INT32 BurnTimerInit(INT32 (*)(INT32, INT32), double (*)()) { return 0; }
+void BurnTimerExit() { }
+void BurnTimerReset() { }
+void BurnTimerScan(INT32, INT32*) { }
+
+// ----------------------------------------------------------------------------
+// Trace
+
+struct TraceRecord { UINT32 nTime; UINT8 nPort; UINT8 nData; };
+
+static TraceRecord* pTrace = NULL;
+static INT32 nTraceLen = 0;
+static INT32 nTraceFrames = 0;
+static UINT32 nTraceClock = 8000000;
+
+static UINT32 nCurrentTime = 0;			// in 1/BURN_YM2610_TRACE_RATE s since the start of the frame
+
+static UINT32 ReadLong(const UINT8* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static INT32 LoadTrace(const char* pszName)
+{
+	FILE* f = fopen(pszName, "rb");
+	UINT8 b[12];
+
+	if (f == NULL) {
+		fprintf(stderr, "can't open trace %s\n", pszName);
+		return 1;
+	}
+
+	if (fread(b, 1, 12, f) != 12 || memcmp(b, BURN_YM2610_TRACE_MAGIC, 4)) {
+		fprintf(stderr, "%s isn't a YM2610 trace\n", pszName);
+		fclose(f);
+		return 1;
+	}
+
+	nTraceClock = ReadLong(b + 4);
+	nBurnFPS = ReadLong(b + 8);
+
+	fseek(f, 0, SEEK_END);
+	nTraceLen = (ftell(f) - 12) / 8;
+	fseek(f, 12, SEEK_SET);
+
+	pTrace = (TraceRecord*)malloc((nTraceLen + 1) * sizeof(TraceRecord));
+
+	for (INT32 i = 0; i < nTraceLen; i++) {
+		if (fread(b, 1, 8, f) != 8) {
+			nTraceLen = i;
+			break;
+		}
+		pTrace[i].nTime = ReadLong(b);
+		pTrace[i].nPort = b[4];
+		pTrace[i].nData = b[5];
+
+		if (pTrace[i].nTime == BURN_YM2610_TRACE_FRAME) {
+			nTraceFrames++;
+		}
+	}
+
+	fclose(f);
+
+	if (nTraceFrames == 0) {
+		fprintf(stderr, "%s doesn't contain a complete frame\n", pszName);
+		return 1;
+	}
+
+	return 0;
+}
+
+static INT32 BenchSynchroniseStream(INT32 nSoundRate)
+{
+	return (INT64)nCurrentTime * nSoundRate / BURN_YM2610_TRACE_RATE;
+}
+
+static double BenchGetTime()
+{
+	return (double)nCurrentTime / BURN_YM2610_TRACE_RATE;
+}
+
+static void BenchIRQHandler(INT32, INT32) { }
+
+// Apply the writes of the next frame of the trace, looping at the end.
+// With bUpdate set the stream is brought up to date before each write.
+static INT32 nTracePos = 0;
+
+static void ReplayFrame(bool bUpdate)
+{
+	for (;;) {
+		if (nTracePos >= nTraceLen) {
+			nTracePos = 0;
+		}
+
+		TraceRecord* r = &pTrace[nTracePos++];
+		if (r->nTime == BURN_YM2610_TRACE_FRAME) {
+			break;
+		}
+
+		nCurrentTime = bUpdate ? r->nTime : 0;
+		BurnYM2610Write(r->nPort & 3, r->nData);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+static UINT8* pADPCMA = NULL;
+static UINT8* pADPCMB = NULL;
+static INT32 nADPCMASize = 0;
+static INT32 nADPCMBSize = 0;
+
+static INT32 LoadRom(const char* pszName, UINT8** pRom, INT32* pnSize)
+{
+	FILE* f = fopen(pszName, "rb");
+
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s\n", pszName);
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	INT32 nLen = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	*pRom = (UINT8*)realloc(*pRom, *pnSize + nLen);
+	if (fread(*pRom + *pnSize, 1, nLen, f) != (size_t)nLen) {
+		fprintf(stderr, "error reading %s\n", pszName);
+		fclose(f);
+		return 1;
+	}
+	*pnSize += nLen;
+
+	fclose(f);
+
+	return 0;
+}
+
+// 64-bit FNV-1a
+static UINT64 Hash(UINT64 h, const INT16* p, INT32 nLen)
+{
+	for (INT32 i = 0; i < nLen; i++) {
+		h = (h ^ (UINT8)p[i]) * 0x100000001b3ULL;
+		h = (h ^ (UINT8)(p[i] >> 8)) * 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+static double Seconds(clock_t nTicks)
+{
+	return (double)nTicks / CLOCKS_PER_SEC;
+}
+
+static void Start(INT32 nRate)
+{
+	nBurnSoundRate = nRate;
+	nBurnSoundLen = (nRate * 100 + nBurnFPS / 2) / nBurnFPS;
+	nTracePos = 0;
+	nCurrentTime = 0;
+	dTime = 0.0;
+
+	BurnYM2610Init(nTraceClock, pADPCMA, &nADPCMASize, pADPCMB, &nADPCMBSize, &BenchIRQHandler, BenchSynchroniseStream, BenchGetTime, 0);
+	BurnYM2610Reset();
+}
+
+static void BenchStack(INT32 nRate, INT32 nFrames)
+{
+	INT16* pSoundBuf;
+	UINT64 nHash = 0xcbf29ce484222325ULL;
+	clock_t nTicks = 0;
+
+	Start(nRate);
+
+	pSoundBuf = (INT16*)malloc(nBurnSoundLen * 2 * sizeof(INT16));
+
+	for (INT32 i = 0; i < nFrames; i++) {
+		clock_t nStart = clock();
+
+		ReplayFrame(true);
+		BurnYM2610Update(pSoundBuf, nBurnSoundLen);
+
+		nTicks += clock() - nStart;
+
+		nHash = Hash(nHash, pSoundBuf, nBurnSoundLen * 2);
+	}
+
+	printf("%6d Hz  BurnYM2610Update  %10.0f samples/s  %7.1fx realtime  hash %016llx\n",
+		nRate, (double)nFrames * nBurnSoundLen / Seconds(nTicks), (double)nFrames * 100 / nBurnFPS / Seconds(nTicks), (unsigned long long)nHash);
+
+	BurnYM2610Exit();
+	free(pSoundBuf);
+}
+
+static void BenchChips(INT32 nRate, INT32 nFrames)
+{
+	INT16* pBuf;
+	INT16* pFM[2];
+	INT16* pSSG[3];
+	UINT64 nHash = 0xcbf29ce484222325ULL;
+	clock_t nTicksFM = 0, nTicksSSG = 0;
+
+	Start(nRate);
+
+	pBuf = (INT16*)malloc(nBurnSoundLen * 5 * sizeof(INT16));
+	for (INT32 j = 0; j < 2; j++) {
+		pFM[j] = pBuf + j * nBurnSoundLen;
+	}
+	for (INT32 j = 0; j < 3; j++) {
+		pSSG[j] = pBuf + (2 + j) * nBurnSoundLen;
+	}
+
+	for (INT32 i = 0; i < nFrames; i++) {
+		clock_t nStart;
+
+		ReplayFrame(false);
+
+		nStart = clock();
+		YM2610UpdateOne(0, pFM, nBurnSoundLen);
+		nTicksFM += clock() - nStart;
+
+		nStart = clock();
+		AY8910Update(0, pSSG, nBurnSoundLen);
+		nTicksSSG += clock() - nStart;
+
+		nHash = Hash(nHash, pFM[0], nBurnSoundLen);
+		nHash = Hash(nHash, pFM[1], nBurnSoundLen);
+		nHash = Hash(nHash, pSSG[0], nBurnSoundLen);
+		nHash = Hash(nHash, pSSG[1], nBurnSoundLen);
+		nHash = Hash(nHash, pSSG[2], nBurnSoundLen);
+	}
+
+	printf("%6d Hz  YM2610UpdateOne   %10.0f samples/s\n", nRate, (double)nFrames * nBurnSoundLen / Seconds(nTicksFM));
+	printf("%6d Hz  AY8910Update      %10.0f samples/s\n", nRate, (double)nFrames * nBurnSoundLen / Seconds(nTicksSSG));
+	printf("%6d Hz  FM and SSG output                                          hash %016llx\n", nRate, (unsigned long long)nHash);
+
+	BurnYM2610Exit();
+	free(pBuf);
+}
+
+int main(int argc, char* argv[])
+{
+	INT32 nRates[16] = { 22050, 44100, 48000 };
+	INT32 nNumRates = 3;
+	INT32 nSeconds = 60;
+	bool bChips = false;
+	const char* pszADPCMB = NULL;
+	INT32 i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-c")) {
+			bChips = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			break;
+		}
+		if (!strcmp(argv[i], "-r")) {
+			char* p = argv[++i];
+			for (nNumRates = 0; *p && nNumRates < 16; nNumRates++) {
+				nRates[nNumRates] = strtol(p, &p, 10);
+				if (*p == ',') p++;
+			}
+		} else if (!strcmp(argv[i], "-s")) {
+			nSeconds = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-i")) {
+			nFMInterpolation = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-b")) {
+			pszADPCMB = argv[++i];
+		} else {
+			break;
+		}
+	}
+
+	if (argc - i < 2) {
+		fprintf(stderr, "usage: %s [-r rate[,rate...]] [-s seconds] [-i interpolation] [-b vrom] [-c] trace vrom [vrom...]\n", argv[0]);
+		return 1;
+	}
+
+	if (LoadTrace(argv[i++])) {
+		return 1;
+	}
+	for (; i < argc; i++) {
+		if (LoadRom(argv[i], &pADPCMA, &nADPCMASize)) {
+			return 1;
+		}
+	}
+	if (pszADPCMB) {
+		if (LoadRom(pszADPCMB, &pADPCMB, &nADPCMBSize)) {
+			return 1;
+		}
+	} else {
+		pADPCMB = pADPCMA;
+		nADPCMBSize = nADPCMASize;
+	}
+
+	// BurnYM2610 mixes in buffers of 4096 samples, 4 of which are kept for interpolation
+	for (i = 0; i < nNumRates; i++) {
+		if (nRates[i] <= 0 || (nRates[i] * 100 + nBurnFPS / 2) / nBurnFPS > 4092) {
+			fprintf(stderr, "%s: rate %d out of range, at most %d Hz\n", argv[0], nRates[i], 4092 * nBurnFPS / 100);
+			return 1;
+		}
+	}
+
+	// BurnYM2610Update() resamples through the 4-point interpolation table BurnLibInit() would build
+	cmc_4p_Precalc();
+
+	INT32 nFrames = nSeconds * nBurnFPS / 100;
+
+	printf("trace: %d frames, %d writes, %d.%02d fps; rendering %d seconds per rate\n", nTraceFrames, nTraceLen - nTraceFrames, nBurnFPS / 100, nBurnFPS % 100, nSeconds);
+
+	for (i = 0; i < nNumRates; i++) {
+		BenchStack(nRates[i], nFrames);
+		if (bChips) {
+			BenchChips(nRates[i], nFrames);
+		}
+	}
+
+	return 0;
+}
@@ -457,11 +457,11 @@ void _7z_file_cache_clear(void)
 
 
 /*-------------------------------------------------
-    _7z_file_decompress - decompress a file
-    from a _7Z into the target buffer
+    _7z_file_extract - decompress a file from a
+    _7Z into the archive's block cache
 -------------------------------------------------*/
 
-_7z_error _7z_file_decompress(_7z_file *new_7z, void *buffer, UINT32 length, UINT32 *Processed)
+_7z_error _7z_file_extract(_7z_file *new_7z, const UINT8 **data, UINT32 *Processed)
 {
 	SRes res;
 	int index = new_7z->curr_file_idx;
@@ -488,8 +488,26 @@ _7z_error _7z_file_decompress(_7z_file *new_7z, void *buffer, UINT32 length, UIN
 		return _7ZERR_FILE_ERROR;
 		
 	*Processed = outSizeProcessed;
+	*data = new_7z->outBuffer + offset;
+
+	return _7ZERR_NONE;
+}
+
+
+/*-------------------------------------------------
+    _7z_file_decompress - decompress a file
+    from a _7Z into the target buffer
+-------------------------------------------------*/
+
+_7z_error _7z_file_decompress(_7z_file *new_7z, void *buffer, UINT32 length, UINT32 *Processed)
+{
+	const UINT8 *data = NULL;
+
+	_7z_error _7zerr = _7z_file_extract(new_7z, &data, Processed);
+	if (_7zerr != _7ZERR_NONE)
+		return _7zerr;
 
-	memcpy(buffer, new_7z->outBuffer + offset, length);
+	memcpy(buffer, data, length);
 
 	return _7ZERR_NONE;
 }
@@ -179,5 +179,9 @@ int _7z_search_crc_match(_7z_file *new_7z, UINT32 crc, const char *search_filena
 /* decompress the most recently found file in the _7Z */
 _7z_error _7z_file_decompress(_7z_file *new_7z, void *buffer, UINT32 length, UINT32 *Processed);
 
+/* extract the most recently found file in the _7Z, *data points into the archive's block cache
+   and stays valid until the next extract or close */
+_7z_error _7z_file_extract(_7z_file *new_7z, const UINT8 **data, UINT32 *Processed);
+
 
 #endif	/* __UN_7Z_H__ */
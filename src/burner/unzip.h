@@ -345,6 +345,11 @@ extern uLong ZEXPORT unzGetOffset (unzFile file);
 /* Set the current file offset */
 extern int ZEXPORT unzSetOffset (unzFile file, uLong pos);
 
+/* Get the position in the zipfile of the next (compressed) byte of the
+   current file, or 0 if no file is opened. Right after unzOpenCurrentFile
+   this is where the file's data starts */
+extern uLong ZEXPORT unzGetCurrentFileZStreamPos (unzFile file);
+
 
 
 #ifdef __cplusplus
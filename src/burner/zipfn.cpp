@@ -15,6 +15,11 @@ static INT32 nFileType = ZIPFN_FILETYPE_NONE;
 
 static unzFile Zip = NULL;
 static INT32 nCurrFile = 0; // The current file we are pointing to
+static char szZipName[MAX_PATH];
+
+// Position of every entry in the central directory, built the first time an entry is loaded
+static unz_file_pos* ZipIndex = NULL;
+static INT32 nZipIndexLen = 0;
 
 #ifdef INCLUDE_7Z_SUPPORT
 static _7z_file* _7ZipFile = NULL;
@@ -34,6 +39,7 @@ INT32 ZipOpen(char* szZip)
 		nFileType = ZIPFN_FILETYPE_ZIP;
 		unzGoToFirstFile(Zip);
 		nCurrFile = 0;
+		strcpy(szZipName, szFileName);
 		
 		return 0;
 	}
@@ -61,6 +67,12 @@ INT32 ZipClose()
 		}
 	}
 
+	if (ZipIndex != NULL) {
+		free(ZipIndex);
+		ZipIndex = NULL;
+	}
+	nZipIndexLen = 0;
+
 #ifdef INCLUDE_7Z_SUPPORT
 	if (nFileType == ZIPFN_FILETYPE_7ZIP) {
 		if (_7ZipFile != NULL) {
@@ -195,6 +207,59 @@ INT32 ZipGetList(struct ZipEntry** pList, INT32* pnListCount)
 	return 0;
 }
 
+static INT32 ZipBuildIndex()
+{
+	unz_global_info ZipGlobalInfo;
+	memset(&ZipGlobalInfo, 0, sizeof(ZipGlobalInfo));
+
+	if (unzGetGlobalInfo(Zip, &ZipGlobalInfo) != UNZ_OK) return 1;
+
+	ZipIndex = (unz_file_pos*)malloc((ZipGlobalInfo.number_entry + 1) * sizeof(unz_file_pos));
+	if (ZipIndex == NULL) return 1;
+
+	nZipIndexLen = 0;
+	for (INT32 nRet = unzGoToFirstFile(Zip); nRet == UNZ_OK && nZipIndexLen < (INT32)ZipGlobalInfo.number_entry; nRet = unzGoToNextFile(Zip)) {
+		if (unzGetFilePos(Zip, &ZipIndex[nZipIndexLen]) != UNZ_OK) break;
+		nZipIndexLen++;
+	}
+
+	unzGoToFirstFile(Zip);
+	nCurrFile = 0;
+
+	return 0;
+}
+
+// Make nEntry the current file of the zip
+static INT32 ZipGoToEntry(INT32 nEntry)
+{
+	if (ZipIndex == NULL) {
+		ZipBuildIndex();
+	}
+
+	if (nEntry < nZipIndexLen) {
+		if (unzGoToFilePos(Zip, &ZipIndex[nEntry]) != UNZ_OK) return 1;
+		nCurrFile = nEntry;
+
+		return 0;
+	}
+
+	if (nEntry < nCurrFile)
+	{
+		// We'll have to go through the zip file again to get to our entry
+		if (unzGoToFirstFile(Zip) != UNZ_OK) return 1;
+		nCurrFile = 0;
+	}
+
+	// Now step through to the file we need
+	while (nCurrFile < nEntry)
+	{
+		if (unzGoToNextFile(Zip) != UNZ_OK) return 1;
+		nCurrFile++;
+	}
+
+	return 0;
+}
+
 INT32 ZipLoadFile(UINT8* Dest, INT32 nLen, INT32* pnWrote, INT32 nEntry)
 {
 	if (nFileType == ZIPFN_FILETYPE_ZIP && Zip == NULL) return 1;
@@ -206,21 +271,7 @@ INT32 ZipLoadFile(UINT8* Dest, INT32 nLen, INT32* pnWrote, INT32 nEntry)
 	INT32 nRet = 0;
 	
 	if (nFileType == ZIPFN_FILETYPE_ZIP) {
-		if (nEntry < nCurrFile)
-		{
-			// We'll have to go through the zip file again to get to our entry
-			nRet = unzGoToFirstFile(Zip);
-			if (nRet != UNZ_OK) return 1;
-			nCurrFile = 0;
-		}
-
-		// Now step through to the file we need
-		while (nCurrFile < nEntry)
-		{
-			nRet = unzGoToNextFile(Zip);
-			if (nRet != UNZ_OK) return 1;
-			nCurrFile++;
-		}
+		if (ZipGoToEntry(nEntry)) return 1;
 
 		nRet = unzOpenCurrentFile(Zip);
 		if (nRet != UNZ_OK) return 1;
@@ -256,6 +307,169 @@ INT32 ZipLoadFile(UINT8* Dest, INT32 nLen, INT32* pnWrote, INT32 nEntry)
 	return 0;
 }
 
+// Returns 0 if a zip entry is stored without compression or encryption, so its data can be read (or
+// mapped) straight from the archive. If pnOffset isn't NULL it receives the position of that data
+INT32 ZipGetStoredEntry(INT32 nEntry, char** pszZip, INT64* pnOffset)
+{
+	unz_file_info FileInfo;
+
+	if (nFileType != ZIPFN_FILETYPE_ZIP || Zip == NULL) return 1;
+
+	if (ZipGoToEntry(nEntry)) return 1;
+
+	if (unzGetCurrentFileInfo(Zip, &FileInfo, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK) return 1;
+	if (FileInfo.compression_method != 0 || (FileInfo.flag & 1) || FileInfo.compressed_size != FileInfo.uncompressed_size) return 1;
+
+	if (pszZip != NULL) *pszZip = szZipName;
+
+	if (pnOffset != NULL) {
+		// The local header has its own (variable length) fields, the data only starts after those
+		if (unzOpenCurrentFile(Zip) != UNZ_OK) return 1;
+		*pnOffset = unzGetCurrentFileZStreamPos(Zip);
+		unzCloseCurrentFile(Zip);
+
+		if (*pnOffset == 0) return 1;
+	}
+
+	return 0;
+}
+
+// Read a file in blocks of ZIP_CHUNK_LEN bytes and pass them to pChunk in order, so a ROM never has to
+// be held in memory whole on its way to the driver
+#define ZIP_CHUNK_LEN	(0x40000)
+
+INT32 ZipLoadFileChunked(INT32 nLen, INT32* pnWrote, INT32 nEntry, BurnLoadRomChunk pChunk, void* pParam)
+{
+	if (nFileType == ZIPFN_FILETYPE_ZIP && Zip == NULL) return 1;
+
+#ifdef INCLUDE_7Z_SUPPORT
+	if (nFileType == ZIPFN_FILETYPE_7ZIP && _7ZipFile == NULL) return 1;
+#endif
+
+	INT32 nRet = 0;
+
+	if (nFileType == ZIPFN_FILETYPE_ZIP) {
+		if (ZipGoToEntry(nEntry)) return 1;
+
+		UINT8* pBuf = (UINT8*)malloc(ZIP_CHUNK_LEN);
+		if (pBuf == NULL) return 1;
+
+		nRet = unzOpenCurrentFile(Zip);
+		if (nRet != UNZ_OK) { free(pBuf); return 1; }
+
+		INT32 nOffset = 0;
+		INT32 nRead = 0;
+
+		while (nOffset < nLen) {
+			nRead = unzReadCurrentFile(Zip, pBuf, (nLen - nOffset < ZIP_CHUNK_LEN) ? (nLen - nOffset) : ZIP_CHUNK_LEN);
+			if (nRead <= 0) break;
+
+			if (pChunk(pBuf, nOffset, nRead, pParam)) {
+				nRead = -1;
+				break;
+			}
+			nOffset += nRead;
+		}
+
+		free(pBuf);
+
+		if (nRead < 0) {
+			unzCloseCurrentFile(Zip);
+			return 1;
+		}
+
+		// Return how many bytes were copied
+		if (pnWrote != NULL) *pnWrote = nOffset;
+
+		nRet = unzCloseCurrentFile(Zip);
+		if (nRet == UNZ_CRCERROR) return 2;
+		if (nRet != UNZ_OK) return 1;
+	}
+
+#ifdef INCLUDE_7Z_SUPPORT
+	if (nFileType == ZIPFN_FILETYPE_7ZIP) {
+		_7ZipFile->curr_file_idx = nEntry;
+		UINT32 nWrote = 0;
+		const UINT8* pData = NULL;
+
+		UINT32 crc = _7ZipFile->db.CRCs.Vals[nEntry];
+
+		// The whole file is already inflated in the archive's block cache
+		_7z_error _7zerr = _7z_file_extract(_7ZipFile, &pData, &nWrote);
+		if (_7zerr != _7ZERR_NONE) return 1;
+
+		UINT32 nCalcCrc = crc32(0, pData, nWrote);
+
+		if (nWrote > (UINT32)nLen) nWrote = nLen;
+
+		for (UINT32 nOffset = 0; nOffset < nWrote; nOffset += ZIP_CHUNK_LEN) {
+			INT32 nChunkLen = (nWrote - nOffset < ZIP_CHUNK_LEN) ? (nWrote - nOffset) : ZIP_CHUNK_LEN;
+
+			if (pChunk((UINT8*)pData + nOffset, nOffset, nChunkLen, pParam)) return 1;
+		}
+
+		// Return how many bytes were copied
+		if (pnWrote != NULL) *pnWrote = (INT32)nWrote;
+
+		if (nCalcCrc != crc) return 2;
+	}
+#endif
+
+	return 0;
+}
+
+// Load several entries of the open archive at once. Every zip entry is inflated through its own
+// handle on the archive, so they can be spread over BurnThreadRun(); 7z archives share one block
+// cache and are loaded in turn. Each request gets the same result ZipLoadFile() would return
+static void ZipLoadFilesJob(INT32 nIndex, void* pParam)
+{
+	ZipLoadRequest* pRequest = (ZipLoadRequest*)pParam + nIndex;
+
+	pRequest->nRet = 1;
+	pRequest->nWrote = 0;
+
+	unzFile ZipJob = unzOpen(szZipName);
+	if (ZipJob == NULL) return;
+
+	if (unzGoToFilePos(ZipJob, &ZipIndex[pRequest->nEntry]) == UNZ_OK && unzOpenCurrentFile(ZipJob) == UNZ_OK) {
+		INT32 nRet = unzReadCurrentFile(ZipJob, pRequest->Dest, pRequest->nLen);
+		if (nRet >= 0) pRequest->nWrote = nRet;
+
+		nRet = unzCloseCurrentFile(ZipJob);
+		pRequest->nRet = (nRet == UNZ_CRCERROR) ? 2 : (nRet != UNZ_OK);
+	}
+
+	unzClose(ZipJob);
+}
+
+INT32 ZipLoadFiles(struct ZipLoadRequest* pRequests, INT32 nCount)
+{
+	if (nFileType == ZIPFN_FILETYPE_ZIP && Zip == NULL) return 1;
+
+	bool bParallel = (nFileType == ZIPFN_FILETYPE_ZIP) && (nCount > 1) && (BurnThreadCount() > 1);
+
+	if (bParallel) {
+		if (ZipIndex == NULL) {
+			ZipBuildIndex();
+		}
+
+		for (INT32 i = 0; i < nCount; i++) {
+			if (pRequests[i].nEntry >= nZipIndexLen) bParallel = false;
+		}
+	}
+
+	if (bParallel) {
+		BurnThreadRun(ZipLoadFilesJob, pRequests, nCount);
+	} else {
+		for (INT32 i = 0; i < nCount; i++) {
+			pRequests[i].nWrote = 0;
+			pRequests[i].nRet = ZipLoadFile(pRequests[i].Dest, pRequests[i].nLen, &pRequests[i].nWrote, pRequests[i].nEntry);
+		}
+	}
+
+	return 0;
+}
+
 // Load one file directly, added by regret
 INT32 __cdecl ZipLoadOneFile(char* arcName, const char* fileName, void** Dest, INT32* pnWrote)
 {